@@ -1,38 +1,573 @@
-
 #include "randodo.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+
+// Every heap allocation goes through here, so --stats can report how many of them
+// parsing and generation needed.
+static std::atomic<unsigned long> allocationCount(0);
+
+void *operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+// Not inlined, otherwise GCC takes new/free pairs for mismatched allocations.
+__attribute__((noinline)) void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+// Random numbers are produced in bulk (which `{bytes:N}` copies directly), and one of them
+// is used for about 9 digits instead of one.
+typedef Randodo::EntropyPoolingRandomNumberGenerator<Randodo::XoshiroLanesRandomNumberGenerator> RandNumGenerator;
+
+// `make randodo_profile` builds the tool with per-generator profiling counters.
+#ifdef RANDODO_PROFILE
+typedef Randodo::CycleCountingProfiler Profiler;
+#else
+typedef Randodo::NullProfiler Profiler;
+#endif
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static std::string bound(size_t value)
+{
+    return value == static_cast<size_t>(-1) ? "unbounded" : std::to_string(value);
+}
+
+struct Stats
+{
+    double parseTime = 0, optimizeTime = 0, generateTime = 0;
+    unsigned long parseAllocations = 0, generateAllocations = 0;
+    unsigned long rows = 0, bytes = 0;
+    size_t minRowLength = std::numeric_limits<size_t>::max(), maxRowLength = 0;
+    Randodo::WorstCase worstCase{0, 0};
+
+    void addRow(size_t length)
+    {
+        rows++;
+        bytes += length;
+        minRowLength = std::min(minRowLength, length);
+        maxRowLength = std::max(maxRowLength, length);
+    }
+
+    void print(std::ostream &out) const
+    {
+        out << "parse time:         " << parseTime * 1e3 << " ms" << std::endl;
+        out << "optimize time:      " << optimizeTime * 1e3 << " ms" << std::endl;
+        out << "generate time:      " << generateTime * 1e3 << " ms" << std::endl;
+        out << "rows:               " << rows << std::endl;
+        out << "bytes:              " << bytes << std::endl;
+        if (generateTime > 0) {
+            out << "rows/s:             " << rows / generateTime << std::endl;
+            out << "bytes/s:            " << bytes / generateTime << std::endl;
+        }
+        if (rows > 0) {
+            out << "row length avg:     " << static_cast<double>(bytes) / rows << std::endl;
+            out << "row length min:     " << minRowLength << std::endl;
+            out << "row length max:     " << maxRowLength << std::endl;
+        }
+        out << "worst-case bytes:   " << bound(worstCase.bytes) << std::endl;
+        out << "worst-case visits:  " << bound(worstCase.nodeVisits) << std::endl;
+        out << "parse allocations:  " << parseAllocations << std::endl;
+        out << "gen. allocations:   " << generateAllocations << std::endl;
+    }
+};
+
+static void usage()
+{
+    std::cerr << "Usage: randodo [options] <file_name> <generator_name> [how_many=1]" << std::endl;
+    std::cerr << "  --stats              print timings, throughput, row lengths and allocations to stderr" << std::endl;
+    std::cerr << "  --benchmark[=secs]   generate into a null sink for a fixed time (default 1s), implies --stats" << std::endl;
+    std::cerr << "  --parse-threads=n    parse the file on n threads (0: one per core)" << std::endl;
+    std::cerr << "  --iterative-depth=n  generate without recursion if generators are nested deeper than n" << std::endl;
+    std::cerr << "  --max-bytes=n        limit every row to n bytes" << std::endl;
+    std::cerr << "  --max-visits=n       limit every row to n generator visits" << std::endl;
+    std::cerr << "  --on-budget=policy   what to do with rows over the limits: fail (default), truncate or resample" << std::endl;
+    std::cerr << "  --length=n[..m]      generate only rows of exactly n (or n to m) bytes" << std::endl;
+    std::cerr << "  --binary             write every row after its length (4 bytes, little-endian) instead of a newline" << std::endl;
+    std::cerr << "  --match              read rows from stdin instead, write the ones the generator can't generate" << std::endl;
+    std::cerr << "  --count              print how many distinct strings the generator can generate" << std::endl;
+    std::cerr << "  --enumerate          write all of them (or how_many) in lexicographic order instead" << std::endl;
+    std::cerr << "  --sorted             write how_many random distinct strings in lexicographic order" << std::endl;
+    std::cerr << "  --skew=distribution  write how_many strings picked with replacement, some (zipf:s, exp:rate" << std::endl;
+    std::cerr << "                       or hist:w1,w2,...) much more often than the others" << std::endl;
+    std::cerr << "  --part=i/n           enumerate (or sample) only the i-th (from 0) of n equal parts of them" << std::endl;
+    if (Profiler::enabled) {
+        std::cerr << "  --profile-tree       print per-generator counters as a tree to stderr" << std::endl;
+        std::cerr << "  --profile-folded=f   write per-generator cycles as folded stacks (for flamegraph.pl) to f" << std::endl;
+    }
+}
+
+// With --binary rows may contain newlines (or anything else), so they're framed by their length.
+// False for rows of 4 GiB or more, which the 4 bytes can't frame.
+static bool appendLength(std::string &output, size_t length)
+{
+    if (length > 0xffffffffU) {
+        return false;
+    }
+    for (int byte = 0; byte < 4; ++byte) {
+        output += static_cast<char>(static_cast<uint32_t>(length) >> (8 * byte));
+    }
+    return true;
+}
+
+static const char *const ROW_TOO_LONG = "Row of 4 GiB or more can't be written with --binary";
+
+// A row of stdin, framed like the output is.
+static bool readRow(std::istream &in, bool binary, std::string &row)
+{
+    if (!binary) {
+        return static_cast<bool>(std::getline(in, row));
+    }
+    unsigned char prefix[4];
+    if (!in.read(reinterpret_cast<char *>(prefix), sizeof(prefix))) {
+        return false;
+    }
+    row.resize(prefix[0] | prefix[1] << 8 | prefix[2] << 16 | static_cast<uint32_t>(prefix[3]) << 24);
+    return row.empty() || in.read(&row[0], row.size());
+}
+
+// Writes the rows of stdin which don't match the generator, returns how many there were.
+static unsigned long matchRows(const Randodo::Dfa &dfa, bool binary, Stats &stats)
+{
+    enum { BATCH = 4096 };
+    std::vector<std::string> rows(BATCH);
+    std::unique_ptr<bool[]> matches(new bool[BATCH]);
+    unsigned long mismatches = 0;
+    for (bool more = true; more; ) {
+        size_t count = 0;
+        while (count < BATCH && (more = readRow(std::cin, binary, rows[count]))) {
+            stats.addRow(rows[count++].size());
+        }
+        mismatches += count - dfa.matchMany(rows.data(), count, matches.get());
+        for (size_t i = 0; i < count; ++i) {
+            if (!matches[i] && binary) {
+                // read with the same prefix, so never too long for it
+                std::string length;
+                appendLength(length, rows[i].size());
+                std::cout << length << rows[i];
+            } else if (!matches[i]) {
+                std::cout << rows[i] << '\n';
+            }
+        }
+    }
+    std::cout.flush();
+    return mismatches;
+}
+
+// Appends a row to `rows`, writing them out once there's enough of them. False if it's too
+// long to be written.
+static bool addRow(std::string &rows, const std::string &row, bool binary, Stats &stats)
+{
+    if (binary && !appendLength(rows, row.size())) {
+        return false;
+    }
+    rows += row;
+    if (!binary) {
+        rows += '\n';
+    }
+    stats.addRow(row.size());
+    if (rows.size() >= (1 << 16)) {
+        std::cout.write(rows.data(), rows.size());
+        rows.clear();
+    }
+    return true;
+}
+
+// Writes out what's left of `rows`, false if the last row couldn't be added.
+static bool finishRows(const std::string &rows, bool added)
+{
+    std::cout.write(rows.data(), rows.size());
+    std::cout.flush();
+    return added;
+}
+
+// Writes the strings of indexes [first, last) in lexicographic order.
+static bool enumerateRows(const Randodo::Dfa &dfa, Randodo::LanguageSize first, Randodo::LanguageSize last,
+                          bool binary, Stats &stats)
+{
+    std::string rows;
+    bool added = true;
+    Randodo::Dfa::Enumerator enumerator(dfa, first);
+    for (Randodo::LanguageSize index = first; added && index < last && enumerator.valid(); ++index, enumerator.next()) {
+        added = addRow(rows, enumerator.string(), binary, stats);
+    }
+    return finishRows(rows, added);
+}
+
+// Writes `count` random distinct strings of indexes from [first, last) in lexicographic order.
+static bool sampleSortedRows(const Randodo::Dfa &dfa, Randodo::LanguageSize first, Randodo::LanguageSize last,
+                             Randodo::LanguageSize count, bool binary, Stats &stats)
+{
+    std::string rows, row;
+    bool added = true;
+    Randodo::SortedSample<RandNumGenerator> sample(first, last, count);
+    for (Randodo::LanguageSize index; added && sample.next(index); ) {
+        dfa.unrank(index, row);
+        added = addRow(rows, row, binary, stats);
+    }
+    return finishRows(rows, added);
+}
+
+// Writes `count` random strings, some much more often than the others.
+static bool sampleSkewedRows(const Randodo::Dfa &dfa, const Randodo::Distribution &distribution, int count,
+                             bool binary, Stats &stats)
+{
+    std::string rows, row;
+    bool added = true;
+    Randodo::SkewedLanguageSample<RandNumGenerator> sample(distribution, dfa.languageSize());
+    for (int i = 0; added && i < count && dfa.languageSize() > 0; ++i) {
+        dfa.unrank(sample.next(), row);
+        added = addRow(rows, row, binary, stats);
+    }
+    return finishRows(rows, added);
+}
+
+template<typename ProfilerType>
+bool dumpProfile(ProfilerType &profiler, bool tree, const std::string &foldedFileName)
+{
+    if (tree) {
+        profiler.dumpTree(std::cerr);
+    }
+    if (!foldedFileName.empty()) {
+        std::ofstream folded(foldedFileName);
+        profiler.dumpFoldedStacks(folded);
+        if (!folded.good()) {
+            std::cerr << "Couldn't write " << foldedFileName << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// not static, unlike the functions above: a static overload (or specialization) for the
+// NullProfiler is unused in the profiling build, which warns about it
+template<>
+bool dumpProfile(Randodo::NullProfiler &, bool, const std::string &)
+{
+    return true;
+}
+
 int main(int argc, char **argv)
 {
-    if (argc < 3) {
-        std::cerr << "Usage: randodo <file_name> <generator_name> [how_many=1]" << std::endl;
+    bool printStats = false;
+    double benchmarkSeconds = 0;
+    unsigned parseThreads = 1;
+    long iterativeDepth = -1;
+    Randodo::GenerationBudget budget;
+    bool binary = false;
+    bool match = false;
+    size_t minLength = 0, maxLength = 0; // 0 & 0: any
+    bool count = false;
+    bool enumerate = false;
+    bool sorted = false;
+    bool skewed = false;
+    Randodo::Distribution distribution;
+    unsigned part = 0, parts = 1;
+    bool profileTree = false;
+    std::string profileFolded;
+
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            printStats = true;
+        } else if (strcmp(argv[i], "--benchmark") == 0) {
+            benchmarkSeconds = 1;
+        } else if (strncmp(argv[i], "--benchmark=", 12) == 0) {
+            benchmarkSeconds = atof(argv[i] + 12);
+            if (benchmarkSeconds <= 0) {
+                usage();
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--parse-threads=", 16) == 0) {
+            parseThreads = atoi(argv[i] + 16);
+        } else if (strncmp(argv[i], "--iterative-depth=", 18) == 0) {
+            iterativeDepth = atol(argv[i] + 18);
+        } else if (strncmp(argv[i], "--max-bytes=", 12) == 0) {
+            budget.maxBytes = strtoull(argv[i] + 12, NULL, 10);
+        } else if (strncmp(argv[i], "--max-visits=", 13) == 0) {
+            budget.maxNodeVisits = strtoull(argv[i] + 13, NULL, 10);
+        } else if (strcmp(argv[i], "--on-budget=fail") == 0) {
+            budget.policy = Randodo::GenerationBudget::FAIL;
+        } else if (strcmp(argv[i], "--on-budget=truncate") == 0) {
+            budget.policy = Randodo::GenerationBudget::TRUNCATE;
+        } else if (strcmp(argv[i], "--on-budget=resample") == 0) {
+            budget.policy = Randodo::GenerationBudget::RESAMPLE;
+        } else if (strncmp(argv[i], "--length=", 9) == 0) {
+            char *end;
+            minLength = maxLength = strtoull(argv[i] + 9, &end, 10);
+            if (strncmp(end, "..", 2) == 0) {
+                maxLength = strtoull(end + 2, &end, 10);
+            }
+            if (*end != 0 || maxLength == 0 || minLength > maxLength) {
+                usage();
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            binary = true;
+        } else if (strcmp(argv[i], "--match") == 0) {
+            match = true;
+        } else if (strcmp(argv[i], "--count") == 0) {
+            count = true;
+        } else if (strcmp(argv[i], "--enumerate") == 0) {
+            enumerate = true;
+        } else if (strcmp(argv[i], "--sorted") == 0) {
+            sorted = true;
+        } else if (strncmp(argv[i], "--skew=", 7) == 0) {
+            skewed = true;
+            if (!Randodo::Distribution::parse(argv[i] + 7, distribution)) {
+                usage();
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--part=", 7) == 0) {
+            if (sscanf(argv[i] + 7, "%u/%u", &part, &parts) != 2 || part >= parts) {
+                usage();
+                return -1;
+            }
+        } else if (Profiler::enabled && strcmp(argv[i], "--profile-tree") == 0) {
+            profileTree = true;
+        } else if (Profiler::enabled && strncmp(argv[i], "--profile-folded=", 17) == 0) {
+            profileFolded = argv[i] + 17;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            usage();
+            return -1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    if (positional.size() < 2) {
+        usage();
         return -1;
     }
 
     srand(time(NULL));
 
-    std::string fileName = argv[1], generatorName = argv[2];
+    std::string fileName = positional[0], generatorName = positional[1];
 
     int howMany = 1;
-    if (argc > 3) {
-        howMany = atoi(argv[3]);
+    if (positional.size() > 2) {
+        howMany = atoi(positional[2].c_str());
     }
 
-    Randodo::ConfigFile<> configFile(fileName);
+    Stats stats;
 
-    auto &mapOfGenerators = configFile.getMapOfGenerators();
-    auto iter = mapOfGenerators.find(generatorName);
+    auto start = Clock::now();
+    unsigned long allocationsBefore = allocationCount;
+    Randodo::ConfigFile<Randodo::PlainFileReader, RandNumGenerator, Profiler> configFile(fileName, parseThreads);
+    stats.parseTime = secondsSince(start);
+    stats.parseAllocations = allocationCount - allocationsBefore;
+    if (!configFile.getParseError().empty()) {
+        std::cerr << configFile.getParseError() << std::endl;
+        return -10;
+    }
 
-    if (iter == mapOfGenerators.end()) {
+    if (iterativeDepth >= 0) {
+        configFile.setIterativeEngineDepth(iterativeDepth);
+    }
+    configFile.setBudget(budget);
+
+    start = Clock::now();
+    configFile.optimize();
+    stats.optimizeTime = secondsSince(start);
+
+    auto generatorId = configFile.getMapOfGenerators().lookup(generatorName);
+    Randodo::GenerationContext context;
+
+    if (configFile.getMapOfGenerators().find(generatorName) == configFile.getMapOfGenerators().end()) {
         std::cerr << "Couldn't find specified file or generator" << std::endl;
         return -2;
     }
 
-    for (int i = 0; i < howMany; ++i) {
-        std::stringstream stream;
-        iter->second->generate(stream);
-        std::cout << stream.str() << std::endl;
+    Randodo::Dfa dfa;
+    if ((match || count || enumerate || sorted || skewed) && !configFile.compileDfa(generatorId, dfa)) {
+        std::cerr << "Generator is recursive or too big to be compiled into an automaton" << std::endl;
+        return -6;
+    }
+
+    if (count) {
+        std::cout << (dfa.languageSizeExact() ? "" : "at least ") << Randodo::formatLanguageSize(dfa.languageSize())
+                  << std::endl;
+        return 0;
+    }
+
+    if ((sorted || skewed || parts > 1) && !dfa.languageSizeExact()) {
+        std::cerr << "Generator can generate too many strings to be split or sampled by index" << std::endl;
+        return -9;
+    }
+
+    if (enumerate || sorted) {
+        Randodo::LanguageSize size = dfa.languageSize();
+        Randodo::LanguageSize first = size / parts * part + size % parts * part / parts;
+        Randodo::LanguageSize last = size / parts * (part + 1) + size % parts * (part + 1) / parts;
+        start = Clock::now();
+        bool written;
+        if (sorted) {
+            // the parts are about equal, so are their shares of the rows
+            Randodo::LanguageSize rows = static_cast<Randodo::LanguageSize>(howMany) * (part + 1) / parts
+                - static_cast<Randodo::LanguageSize>(howMany) * part / parts;
+            written = sampleSortedRows(dfa, first, last, rows, binary, stats);
+        } else {
+            if (positional.size() > 2) {
+                last = std::min<Randodo::LanguageSize>(last, first + howMany);
+            }
+            written = enumerateRows(dfa, first, last, binary, stats);
+        }
+        stats.generateTime = secondsSince(start);
+        if (printStats) {
+            stats.print(std::cerr);
+        }
+        if (!written) {
+            std::cerr << ROW_TOO_LONG << std::endl;
+            return -11;
+        }
+        return 0;
+    }
+
+    if (skewed) {
+        start = Clock::now();
+        bool written = sampleSkewedRows(dfa, distribution, howMany, binary, stats);
+        stats.generateTime = secondsSince(start);
+        if (printStats) {
+            stats.print(std::cerr);
+        }
+        if (!written) {
+            std::cerr << ROW_TOO_LONG << std::endl;
+            return -11;
+        }
+        return 0;
+    }
+
+    if (match) {
+        start = Clock::now();
+        unsigned long mismatches = matchRows(dfa, binary, stats);
+        stats.generateTime = secondsSince(start);
+        if (printStats) {
+            stats.print(std::cerr);
+        }
+        if (mismatches > 0) {
+            std::cerr << mismatches << " rows don't match" << std::endl;
+            return -7;
+        }
+        return 0;
+    }
+
+    stats.worstCase = configFile.worstCase(generatorId);
+    if (!budget.unlimited() && !budget.allows(stats.worstCase)) {
+        std::cerr << "Warning: rows may exceed the budget, worst case is " << bound(stats.worstCase.bytes)
+                  << " bytes and " << bound(stats.worstCase.nodeVisits) << " generator visits" << std::endl;
+    }
+
+    std::unique_ptr<Randodo::ExactLengthSampler<RandNumGenerator>> exactLength;
+    if (maxLength > 0) {
+        exactLength.reset(new Randodo::ExactLengthSampler<RandNumGenerator>(
+                *configFile.getMapOfGenerators().get(generatorId), minLength, maxLength));
+        if (!exactLength->possible()) {
+            std::cerr << "Generator can't generate rows of such lengths (or is recursive or nested too deeply)" << std::endl;
+            return -8;
+        }
+    }
+
+    // Rows of a fixed shape (like `[A-Z]{3}-[0-9]{6}`) are generated in blocks, separated by newlines.
+    const Randodo::FixedShape *fixedShape = binary || exactLength ? nullptr : configFile.fixedShape(generatorId);
+    std::string rows;
+
+    start = Clock::now();
+    allocationsBefore = allocationCount;
+    if (benchmarkSeconds > 0) {
+        // The rows go nowhere; checking the clock only every few rows keeps it off the profile.
+        while (secondsSince(start) < benchmarkSeconds) {
+            if (fixedShape) {
+                rows.clear();
+                configFile.generateRows(generatorId, 64, rows);
+            }
+            for (int i = 0; i < 64; ++i) {
+                if (fixedShape) {
+                    stats.addRow(fixedShape->row.size());
+                    continue;
+                }
+                context.clear();
+                if (exactLength) {
+                    exactLength->generate(context);
+                } else {
+                    configFile.generate(generatorId, context);
+                }
+                stats.addRow(context.output().size());
+            }
+        }
+        printStats = true;
+    } else if (fixedShape) {
+        for (int done = 0; done < howMany; done += 4096) {
+            int count = std::min(howMany - done, 4096);
+            rows.clear();
+            configFile.generateRows(generatorId, count, rows);
+            std::cout.write(rows.data(), rows.size());
+            for (int i = 0; i < count; ++i) {
+                stats.addRow(fixedShape->row.size());
+            }
+        }
+        std::cout.flush();
+    } else {
+        for (int i = 0; i < howMany; ++i) {
+            context.clear();
+            if (exactLength) {
+                exactLength->generate(context);
+            } else if (!configFile.generate(generatorId, context)) {
+                if (configFile.budgetExceeded()) {
+                    std::cerr << "Row exceeded the budget" << std::endl;
+                    return -5;
+                }
+                std::cerr << "Generator nested too deeply" << std::endl;
+                return -3;
+            }
+            size_t length = context.output().size();
+            if (binary) {
+                std::string prefix;
+                if (!appendLength(prefix, length)) {
+                    std::cout.flush();
+                    std::cerr << ROW_TOO_LONG << std::endl;
+                    return -11;
+                }
+                std::cout.write(prefix.data(), prefix.size());
+            } else {
+                context.output() += '\n';
+            }
+            std::cout.write(context.output().data(), context.output().size());
+            stats.addRow(length);
+        }
+        std::cout.flush();
+    }
+    stats.generateTime = secondsSince(start);
+    stats.generateAllocations = allocationCount - allocationsBefore;
+
+    if (printStats) {
+        stats.print(std::cerr);
+    }
+
+    if (!dumpProfile(configFile.getProfiler(), profileTree, profileFolded)) {
+        return -4;
     }
 
     return 0;
 }
-
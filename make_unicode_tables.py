@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# Generates randodo_unicode.h: code point ranges of Unicode general categories, for
+# \p{..} in Randodo's character classes. Usage: ./make_unicode_tables.py > randodo_unicode.h
+
+import unicodedata
+
+# unassigned code points, surrogates and private use areas can't be generated
+SKIPPED = {'Cn', 'Cs', 'Co'}
+
+ranges = {}
+for code_point in range(0x110000):
+    category = unicodedata.category(chr(code_point))
+    if category in SKIPPED:
+        continue
+    category_ranges = ranges.setdefault(category, [])
+    if category_ranges and category_ranges[-1][1] == code_point - 1:
+        category_ranges[-1][1] = code_point
+    else:
+        category_ranges.append([code_point, code_point])
+
+print('/* License: GPL v2 */')
+print('/* Contact author: wrochniak@gmail.com */')
+print()
+print('// Generated by make_unicode_tables.py from the Unicode Character Database %s, don\'t edit.'
+      % unicodedata.unidata_version)
+print()
+print('#ifndef RANDODO_UNICODE_H')
+print('#define RANDODO_UNICODE_H')
+print()
+print('#include <cstdint>')
+print()
+print('namespace Randodo')
+print('{')
+print('namespace Unicode')
+print('{')
+print()
+print('struct Range')
+print('{')
+print('    uint32_t from, to;')
+print('};')
+print()
+print('struct Category')
+print('{')
+print('    const char *name;')
+print('    unsigned first, count; // in ranges')
+print('};')
+print()
+print('static const Range ranges[] = {')
+first = 0
+categories = []
+for category in sorted(ranges):
+    print('    // %s' % category)
+    items = ['{0x%x, 0x%x}' % (a, b) for a, b in ranges[category]]
+    for i in range(0, len(items), 6):
+        print('    ' + ', '.join(items[i:i + 6]) + ',')
+    categories.append((category, first, len(ranges[category])))
+    first += len(ranges[category])
+print('};')
+print()
+print('static const Category categories[] = {')
+for name, first, count in categories:
+    print('    {"%s", %d, %d},' % (name, first, count))
+print('};')
+print()
+print('} // namespace Unicode')
+print('} // namespace Randodo')
+print()
+print('#endif')
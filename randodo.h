@@ -5,11 +5,32 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <map>
 #include <memory>
 #include <stack>
 #include <algorithm>
 #include <cassert>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "randodo_unicode.h"
 
 namespace Randodo
 {
@@ -32,214 +53,5539 @@ public:
     }
 };
 
-class Generator
+// Everything a generator needs while generating a single string.
+class GenerationContext
 {
+private:
+    std::string _output;
+    size_t _maxOutputSize = static_cast<size_t>(-1);
+    size_t _maxNodeVisits = static_cast<size_t>(-1);
 public:
-    virtual void generate(std::stringstream &output) = 0;
+    std::string &output()
+    {
+        return _output;
+    }
 
-    virtual bool isEmpty() = 0;
+    // The iterative engine gives up once the output gets longer than this.
+    size_t maxOutputSize() const
+    {
+        return _maxOutputSize;
+    }
 
-    virtual void optimize() = 0;
+    void setMaxOutputSize(size_t size)
+    {
+        _maxOutputSize = size;
+    }
 
-    virtual ~Generator() {}
+    // ... and after visiting that many generators.
+    size_t maxNodeVisits() const
+    {
+        return _maxNodeVisits;
+    }
+
+    void setMaxNodeVisits(size_t visits)
+    {
+        _maxNodeVisits = visits;
+    }
+
+    // Prepares the context for the next string, keeping the allocated memory.
+    void clear()
+    {
+        _output.clear();
+    }
 };
 
-typedef std::map<std::string, std::unique_ptr<Generator>> MapOfGenerators;
+// Uniform number from [0, 1). Random number generator policies are expected to give
+// at least 31 random bits.
+template<typename RandNumGenerator>
+double randomUnit(RandNumGenerator &randNumGenerator)
+{
+    return (static_cast<unsigned>(randNumGenerator.get()) & 0x7fffffffU) * (1.0 / 2147483648.0);
+}
+
+// The same with 62 random bits, from two numbers of the policy.
+template<typename RandNumGenerator>
+long double randomUnit62(RandNumGenerator &randNumGenerator)
+{
+    long double high = randomUnit(randNumGenerator), low = randomUnit(randNumGenerator);
+    return high + low / 2147483648.0L;
+}
 
-class ConstGenerator : public Generator
+// Standard normal number, by the Box-Muller transform.
+template<typename RandNumGenerator>
+double randomNormal(RandNumGenerator &randNumGenerator)
+{
+    double u = 1 - static_cast<double>(randomUnit62(randNumGenerator));
+    double v = static_cast<double>(randomUnit62(randNumGenerator));
+    return std::sqrt(-2 * std::log(u)) * std::cos(6.283185307179586 * v);
+}
+
+// Uniform number from [0, n). Uses the policy's below(n) if it has one (see
+// EntropyPoolingRandomNumberGenerator), get() % n otherwise.
+template<typename RandNumGenerator>
+auto randomBelow(RandNumGenerator &randNumGenerator, size_t n, int) -> decltype(randNumGenerator.below(n))
+{
+    return randNumGenerator.below(n);
+}
+
+template<typename RandNumGenerator>
+size_t randomBelow(RandNumGenerator &randNumGenerator, size_t n, long)
+{
+    return static_cast<size_t>(randNumGenerator.get()) % n;
+}
+
+template<typename RandNumGenerator>
+size_t randomBelow(RandNumGenerator &randNumGenerator, size_t n)
+{
+    return randomBelow(randNumGenerator, n, 0);
+}
+
+// Fills `words` with random numbers (31 bits at least). Uses the policy's fill() if it has
+// one (see XoshiroLanesRandomNumberGenerator), get() otherwise.
+template<typename RandNumGenerator>
+auto randomWords(RandNumGenerator &randNumGenerator, uint32_t *words, size_t count, int)
+    -> decltype(randNumGenerator.fill(words, count))
+{
+    return randNumGenerator.fill(words, count);
+}
+
+template<typename RandNumGenerator>
+void randomWords(RandNumGenerator &randNumGenerator, uint32_t *words, size_t count, long)
+{
+    for (size_t i = 0; i < count; ++i) {
+        words[i] = randNumGenerator.get();
+    }
+}
+
+template<typename RandNumGenerator>
+void randomWords(RandNumGenerator &randNumGenerator, uint32_t *words, size_t count)
+{
+    randomWords(randNumGenerator, words, count, 0);
+}
+
+// Fills `bytes` with random bytes, copied straight from the words of the policy's fill()
+// if it has one (32 random bits each), 3 bytes per get() otherwise.
+template<typename RandNumGenerator>
+auto randomBytes(RandNumGenerator &randNumGenerator, char *bytes, size_t count, int)
+    -> decltype(randNumGenerator.fill(nullptr, 0))
+{
+    uint32_t words[256];
+    while (count > 0) {
+        size_t chunk = std::min(count, sizeof(words));
+        randNumGenerator.fill(words, (chunk + 3) / 4);
+        memcpy(bytes, words, chunk);
+        bytes += chunk;
+        count -= chunk;
+    }
+}
+
+template<typename RandNumGenerator>
+void randomBytes(RandNumGenerator &randNumGenerator, char *bytes, size_t count, long)
+{
+    for (size_t i = 0; i < count; i += 3) {
+        uint32_t word = static_cast<uint32_t>(randNumGenerator.get());
+        for (size_t j = i; j < count && j < i + 3; ++j, word >>= 8) {
+            bytes[j] = static_cast<char>(word);
+        }
+    }
+}
+
+template<typename RandNumGenerator>
+void randomBytes(RandNumGenerator &randNumGenerator, char *bytes, size_t count)
+{
+    randomBytes(randNumGenerator, bytes, count, 0);
+}
+
+// Number from [from, to], from + j with probability proportional to ratio^j (to - j for
+// ratios above 1, with the inverse ratio).
+template<typename RandNumGenerator>
+size_t randomGeometric(RandNumGenerator &randNumGenerator, size_t from, size_t to, double ratio)
+{
+    double n = static_cast<double>(to - from) + 1;
+    double r = ratio > 1 ? 1 / ratio : ratio;
+    double u = randomUnit(randNumGenerator);
+    double j;
+    if (r <= 0) {
+        j = 0;
+    } else if (r > 1 - 1e-12) {
+        j = std::floor(u * n);
+    } else {
+        // inverting the CDF of the geometric distribution truncated to n values
+        double mass = -std::expm1(n * std::log(r));
+        j = std::floor(std::log1p(-u * mass) / std::log(r));
+    }
+    size_t k = static_cast<size_t>(std::max(0.0, std::min(n - 1, j)));
+    return ratio > 1 ? to - k : from + k;
+}
+
+// Walker's alias method: O(1) sampling of indexes with given (relative) weights.
+class AliasTable
 {
 private:
-    std::string _value;
+    std::vector<double> _probability;
+    std::vector<size_t> _alias;
 public:
-    ConstGenerator(const std::string &value)
-        : _value(value) {}
+    AliasTable() {}
 
-    void generate(std::stringstream &output)
+    // Weights mustn't be negative; if they're all zero, the table stays empty.
+    explicit AliasTable(const std::vector<double> &weights)
     {
-        output << _value;
+        double sum = 0;
+        for (double weight : weights) {
+            sum += weight;
+        }
+        if (!(sum > 0) || std::isinf(sum)) {
+            return;
+        }
+
+        size_t n = weights.size();
+        _probability.resize(n);
+        _alias.resize(n);
+        std::vector<size_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+            _probability[i] = weights[i] * n / sum;
+            (_probability[i] < 1 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            size_t less = small.back(), more = large.back();
+            small.pop_back();
+            _alias[less] = more;
+            _probability[more] -= 1 - _probability[less];
+            if (_probability[more] < 1) {
+                large.pop_back();
+                small.push_back(more);
+            }
+        }
+        // leftovers are 1 up to rounding errors
+        for (size_t i : small) {
+            _probability[i] = 1;
+        }
+        for (size_t i : large) {
+            _probability[i] = 1;
+        }
     }
 
-    bool isEmpty()
+    bool empty() const
     {
-        return _value.size() == 0;
+        return _probability.empty();
+    }
+
+    size_t size() const
+    {
+        return _probability.size();
+    }
+
+    // u is uniform on [0, 1)
+    size_t sample(double u) const
+    {
+        double scaled = u * _probability.size();
+        size_t i = std::min(static_cast<size_t>(scaled), _probability.size() - 1);
+        return scaled - i < _probability[i] ? i : _alias[i];
+    }
+};
+
+// Skew of a random choice among n options (alternatives, characters of a class, strings
+// of a language), valued by their index in the order they're defined in, or of a number
+// of repetitions, valued by the number itself:
+//   zipf:s              value v with probability proportional to 1 / (v + 1)^s
+//   exp:rate            to e^(-rate * v)
+//   geometric:mean      to (mean / (mean + 1))^v, which averages `mean` from 0 on
+//   poisson:mean        Poisson's distribution
+//   normal:mean,sd      the normal distribution, rounded
+//   lognormal:mu,sigma  the log-normal one (of a normal one of mu & sigma), rounded
+//   hist:w1,w2,...      the values are split into as many equal ranges, picked with the
+//                       given weights, and uniformly within them
+// All of them are truncated to the values there are.
+struct Distribution
+{
+    enum Kind { UNIFORM, ZIPF, EXPONENTIAL, GEOMETRIC, POISSON, NORMAL, LOGNORMAL, HISTOGRAM };
+
+    Kind kind = UNIFORM;
+    std::vector<double> parameters;
+    std::string text;
+
+    static bool parse(const std::string &text, Distribution &distribution)
+    {
+        static const struct { const char *name; Kind kind; size_t parameters; } kinds[] = {
+            {"zipf", ZIPF, 1}, {"exp", EXPONENTIAL, 1}, {"geometric", GEOMETRIC, 1}, {"poisson", POISSON, 1},
+            {"normal", NORMAL, 2}, {"lognormal", LOGNORMAL, 2}, {"hist", HISTOGRAM, 0}};
+
+        size_t colon = text.find(':');
+        std::string name = text.substr(0, colon);
+        distribution = Distribution();
+        distribution.text = text;
+        if (name == "uniform") {
+            return colon == std::string::npos;
+        }
+        if (colon == std::string::npos) {
+            return false;
+        }
+        const char *numbers = text.c_str() + colon + 1;
+        for (char *end; ; numbers = end + 1) {
+            double number = strtod(numbers, &end);
+            if (end == numbers || !std::isfinite(number)) {
+                return false;
+            }
+            distribution.parameters.push_back(number);
+            if (*end != ',') {
+                if (*end != 0) {
+                    return false;
+                }
+                break;
+            }
+        }
+        auto &parameters = distribution.parameters;
+        for (auto &kind : kinds) {
+            if (name != kind.name || (kind.parameters != 0 && parameters.size() != kind.parameters)) {
+                continue;
+            }
+            distribution.kind = kind.kind;
+            if (kind.kind == HISTOGRAM) {
+                return *std::min_element(parameters.begin(), parameters.end()) >= 0
+                    && std::accumulate(parameters.begin(), parameters.end(), 0.0) > 0;
+            }
+            // means of normal distributions may be negative, spreads have to be positive
+            return kind.parameters == 2 ? parameters[1] > 0 : parameters[0] >= 0;
+        }
+        return false;
+    }
+
+    // Log of the relative probability of the index-th of n options, valued from `first` on.
+    double logWeight(long double index, long double n, long double first) const
+    {
+        const double minusInfinity = -std::numeric_limits<double>::infinity();
+        long double value = first + index;
+        switch (kind) {
+            case ZIPF:
+                // Zipf's and Poisson's distributions have no negative values
+                return value < 0 ? minusInfinity : -parameters[0] * std::log1p(static_cast<double>(value));
+            case EXPONENTIAL:
+                return -parameters[0] * static_cast<double>(index);
+            case GEOMETRIC:
+                if (parameters[0] == 0) {
+                    return index == 0 ? 0 : minusInfinity;
+                }
+                return static_cast<double>(index) * -std::log1p(1 / parameters[0]);
+            case POISSON:
+                if (value < 0) {
+                    return minusInfinity;
+                }
+                if (parameters[0] == 0) {
+                    return value == 0 ? 0 : minusInfinity;
+                }
+                return static_cast<double>(value * std::log(parameters[0]) - parameters[0] - std::lgamma(value + 1));
+            case NORMAL: {
+                double z = static_cast<double>((value - parameters[0]) / parameters[1]);
+                return -z * z / 2;
+            }
+            case LOGNORMAL: {
+                if (value <= 0) {
+                    return minusInfinity;
+                }
+                double logValue = std::log(static_cast<double>(value)), z = (logValue - parameters[0]) / parameters[1];
+                return -logValue - z * z / 2;
+            }
+            case HISTOGRAM: {
+                // the bucket whose range, [n * b / k, n * (b + 1) / k) rounded down, has the option
+                long double buckets = parameters.size();
+                long double bucket = std::ceil((index + 1) * buckets / n) - 1;
+                long double size = std::floor(n * (bucket + 1) / buckets) - std::floor(n * bucket / buckets);
+                return std::log(parameters[static_cast<size_t>(bucket)] / static_cast<double>(size));
+            }
+            default:
+                return 0;
+        }
+    }
+
+    // Relative probabilities of n options, all 0 if none is possible.
+    std::vector<double> weights(size_t n, size_t first = 0) const
+    {
+        std::vector<double> weights(n);
+        double most = -std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < n; ++i) {
+            weights[i] = logWeight(i, n, first);
+            most = std::max(most, weights[i]);
+        }
+        for (double &weight : weights) {
+            weight = std::isinf(most) ? 0 : std::exp(weight - most);
+        }
+        return weights;
+    }
+
+    // Value above which the distribution's tail is negligible (infinite if there's none),
+    // to bound `*` and `+` repetitions.
+    long double upperBound(long double first) const
+    {
+        switch (kind) {
+            case EXPONENTIAL:
+                return parameters[0] > 0 ? first + 42 / parameters[0] : std::numeric_limits<long double>::infinity();
+            case GEOMETRIC:
+                return first + 42 * (parameters[0] + 1);
+            case POISSON:
+                return std::max<long double>(first, parameters[0] + 10 * std::sqrt(parameters[0]) + 20);
+            case NORMAL:
+                return std::max<long double>(first, parameters[0] + 9 * parameters[1]);
+            case LOGNORMAL:
+                return std::max<long double>(first, std::exp(static_cast<long double>(parameters[0]) + 9 * parameters[1]));
+            case HISTOGRAM:
+                return first + parameters.size() - 1;
+            default:
+                return std::numeric_limits<long double>::infinity();
+        }
+    }
+
+    // The distribution of its values multiplied by `factor`, for the kinds that have a
+    // scale, e.g. of cents rather than of dollars.
+    Distribution scaled(double factor) const
+    {
+        Distribution result = *this;
+        switch (kind) {
+            case EXPONENTIAL:
+                result.parameters[0] /= factor;
+                break;
+            case GEOMETRIC:
+                result.parameters[0] *= factor;
+                break;
+            case NORMAL:
+                result.parameters[0] *= factor;
+                result.parameters[1] *= factor;
+                break;
+            case LOGNORMAL:
+                result.parameters[0] += std::log(factor);
+                break;
+            default:
+                break;
+        }
+        return result;
+    }
+};
+
+// O(1) sampling of one of n options following a Distribution: from an alias table when
+// they're few, otherwise by rejection-inversion (Hörmann & Derflinger) for Zipf's law,
+// by inverting the CDF for exponential and geometric ones, from an alias table of the
+// buckets for histograms, and by drawing values until one is in range for the others
+// (Poisson's by PTRS, also by Hörmann). n may be as big as a language.
+class SkewedIndex
+{
+private:
+    enum { MAX_TABLE_SIZE = 4096, MAX_ATTEMPTS = 64 };
+
+    Distribution _distribution;
+    long double _n = 0, _first = 0;
+    AliasTable _table; // of the options, or of the buckets of a histogram
+    double _hIntegralX1 = 0, _hIntegralN = 0, _threshold = 0; // of the rejection-inversion
+    double _rate = 0; // of exponential and geometric distributions
+    long double _exponentialMass = 0;
+
+    // log1p(x) / x and expm1(x) / x, accurate near 0 too
+    static double helper1(double x)
+    {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x * (0.5 - x * (1 / 3.0 - 0.25 * x));
+    }
+
+    static double helper2(double x)
+    {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3.0 * (1 + 0.25 * x));
+    }
+
+    // 1 / x^s, its integral and the integral's inverse
+    double h(double x) const
+    {
+        return std::exp(-_distribution.parameters[0] * std::log(x));
+    }
+
+    double hIntegral(double x) const
+    {
+        double logX = std::log(x);
+        return helper2((1 - _distribution.parameters[0]) * logX) * logX;
+    }
+
+    double hIntegralInverse(double x) const
+    {
+        double t = std::max(-1.0, x * (1 - _distribution.parameters[0]));
+        return std::exp(helper1(t) * x);
+    }
+
+    // from [max(_first, 0) + 1, _first + _n]
+    template<typename RandNumGenerator>
+    long double zipf(RandNumGenerator &randNumGenerator) const
+    {
+        for (;;) {
+            double u = _hIntegralN + static_cast<double>(randomUnit62(randNumGenerator)) * (_hIntegralX1 - _hIntegralN);
+            double x = hIntegralInverse(u);
+            long double k = std::min(_first + _n, std::max(std::max(_first, 0.0L) + 1, std::floor(static_cast<long double>(x) + 0.5L)));
+            if (k - x <= _threshold || u >= hIntegral(static_cast<double>(k) + 0.5) - h(static_cast<double>(k))) {
+                return k;
+            }
+        }
+    }
+
+    template<typename RandNumGenerator>
+    static long double poisson(RandNumGenerator &randNumGenerator, double mean)
+    {
+        if (mean < 10) {
+            // multiplying uniform numbers until their product drops below e^-mean
+            double limit = std::exp(-mean), product = 1;
+            long double k = -1;
+            do {
+                product *= static_cast<double>(randomUnit62(randNumGenerator));
+                ++k;
+            } while (product > limit);
+            return k;
+        }
+        double sqrtMean = std::sqrt(mean), logMean = std::log(mean);
+        double b = 0.931 + 2.53 * sqrtMean, a = -0.059 + 0.02483 * b;
+        double inverseAlpha = 1.1239 + 1.1328 / (b - 3.4), vr = 0.9277 - 3.6224 / (b - 2);
+        for (;;) {
+            double u = static_cast<double>(randomUnit62(randNumGenerator)) - 0.5;
+            double v = static_cast<double>(randomUnit62(randNumGenerator));
+            double us = 0.5 - std::abs(u);
+            double k = std::floor((2 * a / us + b) * u + mean + 0.43);
+            if (us >= 0.07 && v <= vr) {
+                return k;
+            }
+            if (k < 0 || (us < 0.013 && v > us)) {
+                continue;
+            }
+            if (std::log(v) + std::log(inverseAlpha) - std::log(a / (us * us) + b)
+                    <= -mean + k * logMean - std::lgamma(k + 1)) {
+                return k;
+            }
+        }
+    }
+
+    // a value of a distribution without closed-form truncation, not truncated
+    template<typename RandNumGenerator>
+    long double drawValue(RandNumGenerator &randNumGenerator) const
+    {
+        const std::vector<double> &parameters = _distribution.parameters;
+        switch (_distribution.kind) {
+            case Distribution::POISSON:
+                return poisson(randNumGenerator, parameters[0]);
+            case Distribution::NORMAL:
+                return std::floor(parameters[0] + parameters[1] * randomNormal(randNumGenerator) + 0.5);
+            default:
+                return std::floor(std::exp(parameters[0] + parameters[1] * randomNormal(randNumGenerator)) + 0.5);
+        }
+    }
+
+public:
+    SkewedIndex() {}
+
+    // The options are valued from `first` on.
+    SkewedIndex(const Distribution &distribution, long double n, long double first = 0)
+        : _distribution(distribution), _n(n), _first(first)
+    {
+        if (n <= 0) {
+            return;
+        }
+        if (n <= MAX_TABLE_SIZE) {
+            _table = AliasTable(distribution.weights(static_cast<size_t>(n), static_cast<size_t>(first)));
+        } else if (distribution.kind == Distribution::ZIPF && first + n > 0) {
+            double a = static_cast<double>(std::max(first, 0.0L)) + 1, b = static_cast<double>(first + n);
+            _hIntegralX1 = hIntegral(a + 0.5) - h(a);
+            _hIntegralN = hIntegral(b + 0.5);
+            _threshold = a + 1 - hIntegralInverse(hIntegral(a + 1.5) - h(a + 1));
+        } else if (distribution.kind == Distribution::EXPONENTIAL || distribution.kind == Distribution::GEOMETRIC) {
+            _rate = distribution.kind == Distribution::EXPONENTIAL ? distribution.parameters[0]
+                                                                    : std::log1p(1 / distribution.parameters[0]);
+            _exponentialMass = -std::expm1(-_rate * n);
+        } else if (distribution.kind == Distribution::HISTOGRAM) {
+            _table = AliasTable(distribution.parameters);
+        }
+    }
+
+    const Distribution &distribution() const
+    {
+        return _distribution;
+    }
+
+    // From [0, n), as long double so that it works for languages too.
+    template<typename RandNumGenerator>
+    long double sample(RandNumGenerator &randNumGenerator) const
+    {
+        if (_n <= MAX_TABLE_SIZE) {
+            // uniform if none of the options is possible
+            return _table.empty() ? std::floor(randomUnit(randNumGenerator) * _n)
+                                  : _table.sample(randomUnit(randNumGenerator));
+        }
+        long double u = randomUnit62(randNumGenerator), index;
+        switch (_distribution.kind) {
+            case Distribution::ZIPF:
+                if (_first + _n <= 0) {
+                    index = std::floor(u * _n);
+                    break;
+                }
+                return zipf(randNumGenerator) - (_first + 1);
+            case Distribution::EXPONENTIAL:
+            case Distribution::GEOMETRIC:
+                if (_exponentialMass <= 0) {
+                    index = std::floor(u * _n);
+                } else {
+                    index = std::floor(-std::log1p(-u * _exponentialMass) / _rate);
+                }
+                break;
+            case Distribution::HISTOGRAM: {
+                size_t bucket = _table.sample(randomUnit(randNumGenerator)), buckets = _table.size();
+                long double from = std::floor(_n * bucket / buckets), to = std::floor(_n * (bucket + 1) / buckets);
+                index = from + std::floor(u * (to - from));
+                break;
+            }
+            case Distribution::POISSON:
+            case Distribution::NORMAL:
+            case Distribution::LOGNORMAL:
+                // the nearest end if the range keeps being missed, the mass being beyond it
+                for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+                    index = drawValue(randNumGenerator) - _first;
+                    if (index >= 0 && index < _n) {
+                        return index;
+                    }
+                }
+                return index < 0 ? 0 : _n - 1;
+            default:
+                index = std::floor(u * _n);
+        }
+        return std::min(index, _n - 1);
+    }
+};
+
+// Value and derivative of a generating function at some point, see BoltzmannSampler.
+struct BoltzmannWeight
+{
+    double value, derivative;
+
+    BoltzmannWeight operator*(const BoltzmannWeight &other) const
+    {
+        return BoltzmannWeight{value * other.value, derivative * other.value + value * other.derivative};
+    }
+
+    BoltzmannWeight operator+(const BoltzmannWeight &other) const
+    {
+        return BoltzmannWeight{value + other.value, derivative + other.derivative};
+    }
+};
+
+inline size_t saturatingAdd(size_t a, size_t b)
+{
+    return a > static_cast<size_t>(-1) - b ? static_cast<size_t>(-1) : a + b;
+}
+
+inline size_t saturatingMultiply(size_t a, size_t b)
+{
+    return b != 0 && a > static_cast<size_t>(-1) / b ? static_cast<size_t>(-1) : a * b;
+}
+
+// Upper bounds on the length of a generated string and on the number of generators the
+// iterative engine visits to generate it; static_cast<size_t>(-1) means unbounded.
+struct WorstCase
+{
+    size_t bytes, nodeVisits;
+};
+
+// Shape of strings whose structure doesn't depend on random choices, like the ones of
+// `[A-Z]{3}-[0-9]{6}`: a row template, some bytes of which get picked from character sets.
+struct FixedShape
+{
+    enum { MAX_LENGTH = 1 << 16, MAX_DEPTH = 256, MAX_REPETITIONS = 1 << 20 };
+
+    struct Pick
+    {
+        size_t position;
+        std::string chars;
+    };
+
+    std::string row;
+    std::vector<Pick> picks;
+    size_t repetitions = 0; // so far, in all the generators
+
+    bool appendConstant(const std::string &value)
+    {
+        if (row.size() + value.size() > MAX_LENGTH) {
+            return false;
+        }
+        row += value;
+        return true;
+    }
+
+    bool appendPick(const std::string &chars)
+    {
+        if (chars.empty() || row.size() >= MAX_LENGTH) {
+            return false;
+        }
+        picks.push_back(Pick{row.size(), chars});
+        row += chars[0];
+        return true;
+    }
+};
+
+inline size_t utf8Length(uint32_t codePoint)
+{
+    return codePoint < 0x80 ? 1 : codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+}
+
+inline void appendUtf8(std::string &output, uint32_t codePoint)
+{
+    if (codePoint < 0x80) {
+        output += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        char bytes[2] = {static_cast<char>(0xc0 | (codePoint >> 6)), static_cast<char>(0x80 | (codePoint & 0x3f))};
+        output.append(bytes, 2);
+    } else if (codePoint < 0x10000) {
+        char bytes[3] = {static_cast<char>(0xe0 | (codePoint >> 12)), static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)),
+                         static_cast<char>(0x80 | (codePoint & 0x3f))};
+        output.append(bytes, 3);
+    } else {
+        char bytes[4] = {static_cast<char>(0xf0 | (codePoint >> 18)), static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f)),
+                         static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)), static_cast<char>(0x80 | (codePoint & 0x3f))};
+        output.append(bytes, 4);
+    }
+}
+
+// Uniform 64 bits, from three numbers of a random number generator policy.
+template<typename RandNumGenerator>
+uint64_t random64(RandNumGenerator &randNumGenerator)
+{
+    uint64_t high = static_cast<uint32_t>(randNumGenerator.get()) & 0x7fffffffU;
+    uint64_t middle = static_cast<uint32_t>(randNumGenerator.get()) & 0x7fffffffU;
+    uint64_t low = static_cast<uint32_t>(randNumGenerator.get()) & 0x7fffffffU;
+    return high << 62 | middle << 31 | low;
+}
+
+// Uniform number from [0, n), n being 1 to 2^31: the policy's below(n) if it has one,
+// otherwise 31 random bits of which the last 2^31 % n values, those that would make
+// get() % n biased, are drawn again.
+template<typename RandNumGenerator>
+auto randomBelow31(RandNumGenerator &randNumGenerator, uint32_t n, int) -> decltype(randNumGenerator.below(n))
+{
+    return randNumGenerator.below(n);
+}
+
+template<typename RandNumGenerator>
+uint32_t randomBelow31(RandNumGenerator &randNumGenerator, uint32_t n, long)
+{
+    uint32_t limit = 0x80000000U - 0x80000000U % n;
+    uint32_t value;
+    do {
+        value = static_cast<uint32_t>(randNumGenerator.get()) & 0x7fffffffU;
+    } while (value >= limit);
+    return value % n;
+}
+
+// Uniform number from [0, n), n being 2^64 if 0, whatever the policy.
+template<typename RandNumGenerator>
+uint64_t randomBelow64(RandNumGenerator &randNumGenerator, uint64_t n)
+{
+    if (n != 0 && n <= 0x80000000U) {
+        return randomBelow31(randNumGenerator, static_cast<uint32_t>(n), 0);
+    }
+    uint64_t value = random64(randNumGenerator);
+    if (n == 0) {
+        return value;
+    }
+    // rejecting the first 2^64 % n values keeps it uniform
+    while (value < -n % n) {
+        value = random64(randNumGenerator);
+    }
+    return value % n;
+}
+
+// Number of leading zero bits of `value`, which mustn't be 0.
+inline int leadingZeros(uint64_t value)
+{
+#if defined(__GNUC__)
+    return __builtin_clzll(value);
+#else
+    int zeros = 0;
+    for (int shift = 32; shift > 0; shift >>= 1) {
+        if (value >> (64 - shift) == 0) {
+            zeros += shift;
+            value <<= shift;
+        }
+    }
+    return zeros;
+#endif
+}
+
+// Number of trailing zero bits of `value`, which mustn't be 0.
+inline int trailingZeros(uint32_t value)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(value);
+#else
+    int zeros = 0;
+    for (; (value & 1) == 0; value >>= 1) {
+        ++zeros;
+    }
+    return zeros;
+#endif
+}
+
+// Number of digits of `value` in base 10, from its number of bits.
+inline size_t decimalDigits(uint64_t value)
+{
+    static const uint64_t powers[] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+        1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+        100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+        1000000000000000000ULL, 10000000000000000000ULL};
+    value |= 1; // 0 has a digit too, and leadingZeros() needs a bit set
+    size_t guess = (64 - leadingZeros(value)) * 1233 >> 12;
+    return guess - (value < powers[guess]) + 1;
+}
+
+// Number of digits of `value` in base 2 to 36.
+inline size_t digitsInBase(uint64_t value, unsigned base)
+{
+    if (base == 10) {
+        return decimalDigits(value);
+    }
+    if ((base & (base - 1)) == 0) {
+        // neither base nor value | 1 is 0
+        size_t shift = trailingZeros(base);
+        return (64 - leadingZeros(value | 1) + shift - 1) / shift;
+    }
+    size_t digits = 1;
+    for (; value >= base; value /= base) {
+        ++digits;
+    }
+    return digits;
+}
+
+// "00" to "99", the two digits of n at 2 * n.
+inline const char *digitPairs()
+{
+    static const char pairs[] =
+        "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+        "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+    return pairs;
+}
+
+// Appends `value` in base 2 to 36, zero-padded to minDigits, straight into `output`: the
+// digits are written from the last one on, two at a time from a table in base 10.
+inline void appendUnsigned(std::string &output, uint64_t value, unsigned base = 10, size_t minDigits = 0,
+                           bool uppercase = false)
+{
+    const char *pairs = digitPairs();
+    const char *symbols = uppercase ? "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ" : "0123456789abcdefghijklmnopqrstuvwxyz";
+
+    size_t start = output.size(), digits = std::max(minDigits, digitsInBase(value, base));
+    output.resize(start + digits);
+    char *first = &output[start], *p = first + digits;
+    if (base == 10) {
+        while (value >= 100) {
+            p -= 2;
+            memcpy(p, pairs + 2 * (value % 100), 2);
+            value /= 100;
+        }
+        if (value >= 10) {
+            p -= 2;
+            memcpy(p, pairs + 2 * value, 2);
+        } else {
+            *--p = static_cast<char>('0' + value);
+        }
+    } else if ((base & (base - 1)) == 0) {
+        size_t shift = trailingZeros(base); // base is 2 to 36, never 0
+        do {
+            *--p = symbols[value & (base - 1)];
+            value >>= shift;
+        } while (value != 0);
+    } else {
+        do {
+            *--p = symbols[value % base];
+            value /= base;
+        } while (value != 0);
+    }
+    memset(first, '0', p - first);
+}
+
+inline void appendSigned(std::string &output, int64_t value, unsigned base = 10, size_t minDigits = 0,
+                         bool uppercase = false)
+{
+    if (value < 0) {
+        output += '-';
+    }
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    appendUnsigned(output, magnitude, base, minDigits, uppercase);
+}
+
+#if defined(__SIZEOF_INT128__)
+// Grisu2 (Loitsch, "Printing floating-point numbers quickly and accurately with
+// integers"): the digits of a positive double, as few as 64-bit approximations of its
+// rounding interval allow, which is the shortest that reads back as the same double but
+// for about 0.1% of them (then it's one digit more, and still reads back).
+class Grisu2
+{
+private:
+    typedef unsigned __int128 uint128;
+
+    enum { FIRST_POWER = -348, POWER_STEP = 8, POWERS = 87 };
+
+    // f * 2^e
+    struct DiyFp
+    {
+        uint64_t f;
+        int e;
+
+        DiyFp operator-(const DiyFp &other) const
+        {
+            return DiyFp{f - other.f, e};
+        }
+
+        // rounded to 64 bits
+        DiyFp operator*(const DiyFp &other) const
+        {
+            uint128 product = static_cast<uint128>(f) * other.f;
+            return DiyFp{static_cast<uint64_t>(product >> 64) + (static_cast<uint64_t>(product) >> 63), e + other.e + 64};
+        }
+
+        DiyFp normalized() const
+        {
+            int shift = leadingZeros(f); // f isn't 0, digits() only takes values above 0
+            return DiyFp{f << shift, e - shift};
+        }
+    };
+
+    // 10^-348, 10^-340, ..., 10^340 rounded to 64 bits, from multiplications and divisions
+    // by 10 of 128-bit significands (truncating them is way below the rounding)
+    struct CachedPowers
+    {
+        DiyFp powers[POWERS];
+
+        CachedPowers()
+        {
+            const int last = FIRST_POWER + (POWERS - 1) * POWER_STEP;
+            for (int direction = 1; direction >= -1; direction -= 2) {
+                uint128 m = static_cast<uint128>(1) << 127;
+                int e = -127;
+                for (int k = 0; k >= FIRST_POWER && k <= last; k += direction) {
+                    if ((k - FIRST_POWER) % POWER_STEP == 0) {
+                        uint64_t f = static_cast<uint64_t>(m >> 64) + (static_cast<uint64_t>(m) >> 63);
+                        powers[(k - FIRST_POWER) / POWER_STEP] = f == 0 ? DiyFp{1ULL << 63, e + 65} : DiyFp{f, e + 64};
+                    }
+                    if (direction > 0) {
+                        uint128 high = (m >> 64) * 10, low = static_cast<uint128>(static_cast<uint64_t>(m)) * 10;
+                        high += low >> 64;
+                        // m is at least 2^127, so its high half times 10 isn't 0
+                        int shift = 64 - leadingZeros(static_cast<uint64_t>(high >> 64));
+                        m = high << (64 - shift) | static_cast<uint64_t>(low) >> shift;
+                        e += shift;
+                    } else {
+                        uint128 quotient = m / 10, remainder = m % 10;
+                        // nor is the high half of m / 10
+                        int shift = leadingZeros(static_cast<uint64_t>(quotient >> 64));
+                        m = quotient << shift | (remainder << shift) / 10;
+                        e -= shift;
+                    }
+                }
+            }
+        }
+    };
+
+    // 10^-k, such that multiplying a number of exponent e by it makes the exponent of the
+    // product between -60 and -32
+    static DiyFp cachedPower(int e, int &k)
+    {
+        static const CachedPowers cached;
+        double estimate = (-61 - e) * 0.30102999566398114 + 347;
+        int index = static_cast<int>(estimate);
+        if (estimate - index > 0) {
+            ++index;
+        }
+        index = (index >> 3) + 1;
+        k = -(FIRST_POWER + index * POWER_STEP);
+        return cached.powers[index];
+    }
+
+    // moves the last digit down towards w while that stays in the interval
+    static void round(char *digits, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance)
+    {
+        while (rest < distance && delta - rest >= tenKappa
+               && (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+            --digits[length - 1];
+            rest += tenKappa;
+        }
+    }
+
+    // Digits of `high`, the upper bound of the interval, until the rest is within `delta`,
+    // the interval's width; k gets the exponent of the last one.
+    static int generateDigits(const DiyFp &w, const DiyFp &high, uint64_t delta, char *digits, int &k)
+    {
+        static const uint64_t powers[] = {
+            1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+            1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+            100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+            1000000000000000000ULL, 10000000000000000000ULL};
+        const DiyFp one{1ULL << -high.e, high.e};
+        const uint64_t distance = (high - w).f;
+        uint32_t integral = static_cast<uint32_t>(high.f >> -one.e);
+        uint64_t fraction = high.f & (one.f - 1);
+        int length = 0;
+        int kappa = static_cast<int>(decimalDigits(integral));
+        while (kappa > 0) {
+            uint32_t power = static_cast<uint32_t>(powers[kappa - 1]);
+            uint32_t digit = integral / power;
+            integral %= power;
+            if (digit != 0 || length != 0) {
+                digits[length++] = static_cast<char>('0' + digit);
+            }
+            --kappa;
+            uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fraction;
+            if (rest <= delta) {
+                k += kappa;
+                round(digits, length, delta, rest, powers[kappa] << -one.e, distance);
+                return length;
+            }
+        }
+        for (;;) {
+            fraction *= 10;
+            delta *= 10;
+            char digit = static_cast<char>(fraction >> -one.e);
+            if (digit != 0 || length != 0) {
+                digits[length++] = static_cast<char>('0' + digit);
+            }
+            fraction &= one.f - 1;
+            --kappa;
+            if (fraction < delta) {
+                k += kappa;
+                round(digits, length, delta, fraction, one.f, -kappa < 20 ? distance * powers[-kappa] : 0);
+                return length;
+            }
+        }
+    }
+
+public:
+    // Writes the digits of value > 0 (17 at most) and returns how many there are; value is
+    // about them times 10^k.
+    static int digits(double value, char *digits, int &k)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint64_t significand = bits & ((1ULL << 52) - 1);
+        int exponent = static_cast<int>(bits >> 52 & 0x7ff);
+        DiyFp v = exponent != 0 ? DiyFp{significand | 1ULL << 52, exponent - 1075} : DiyFp{significand, -1074};
+        // halfway to the neighbours, the one below being closer at powers of 2
+        DiyFp plus = DiyFp{(v.f << 1) + 1, v.e - 1}.normalized();
+        DiyFp minus = v.f == 1ULL << 52 ? DiyFp{(v.f << 2) - 1, v.e - 2} : DiyFp{(v.f << 1) - 1, v.e - 1};
+        minus = DiyFp{minus.f << (minus.e - plus.e), plus.e};
+        DiyFp power = cachedPower(plus.e, k);
+        DiyFp w = v.normalized() * power, high = plus * power, low = minus * power;
+        ++low.f;
+        --high.f;
+        return generateDigits(w, high, high.f - low.f, digits, k);
+    }
+};
+
+// Appends the shortest string that reads back as `value` (see Grisu2), in plain notation
+// from 1e-6 to 1e21 ("0.25", "100.0"), in scientific one otherwise ("1e-7", "1.5e300").
+inline void appendDouble(std::string &output, double value)
+{
+    if (std::isnan(value)) {
+        output += "nan";
+        return;
+    }
+    if (std::signbit(value)) {
+        output += '-';
+        value = -value;
+    }
+    if (std::isinf(value) || value == 0) {
+        output += value == 0 ? "0.0" : "inf";
+        return;
+    }
+    char digits[20];
+    int k, length = Grisu2::digits(value, digits, k), point = length + k;
+    if (k >= 0 && point <= 21) {
+        output.append(digits, length);
+        output.append(k, '0');
+        output += ".0";
+    } else if (point > 0 && point <= 21) {
+        output.append(digits, point);
+        output += '.';
+        output.append(digits + point, length - point);
+    } else if (point > -6 && point <= 0) {
+        output += "0.";
+        output.append(-point, '0');
+        output.append(digits, length);
+    } else {
+        output += digits[0];
+        if (length > 1) {
+            output += '.';
+            output.append(digits + 1, length - 1);
+        }
+        output += 'e';
+        appendSigned(output, point - 1);
+    }
+}
+#else
+// Appends the shortest of `value`'s forms with 15 to 17 significant digits that reads back.
+inline void appendDouble(std::string &output, double value)
+{
+    char buffer[32];
+    for (int precision = 15; ; ++precision) {
+        snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+        if (precision == 17 || strtod(buffer, nullptr) == value) {
+            break;
+        }
+    }
+    output += buffer;
+}
+#endif
+
+// Nondeterministic automaton over bytes, which generators append themselves to (see
+// Generator::appendToNfa()) to be compiled into a Dfa. Paths between two states are only
+// ever added through new states, so the automaton stays acyclic.
+class Nfa
+{
+public:
+    enum { MAX_STATES = 1 << 20, MAX_DEPTH = 256 };
+
+    struct Edge
+    {
+        unsigned char from, to; // bytes
+        int target;
+    };
+
+    struct State
+    {
+        std::vector<Edge> edges;
+        std::vector<int> epsilons;
+    };
+
+    std::vector<State> states;
+    std::vector<const void *> expanding; // targets of variables being appended, to detect recursion
+
+    // -1 if there are too many
+    int addState()
+    {
+        if (states.size() >= MAX_STATES) {
+            return -1;
+        }
+        states.push_back(State());
+        return static_cast<int>(states.size()) - 1;
+    }
+
+    void addEpsilon(int from, int to)
+    {
+        states[from].epsilons.push_back(to);
+    }
+
+    void addBytes(int from, int to, unsigned char first, unsigned char last)
+    {
+        states[from].edges.push_back(Edge{first, last, to});
+    }
+
+    bool addString(int from, int to, const std::string &value)
+    {
+        int state = from;
+        for (size_t i = 0; i + 1 < value.size(); ++i) {
+            int next = addState();
+            if (next < 0) {
+                return false;
+            }
+            addBytes(state, next, value[i], value[i]);
+            state = next;
+        }
+        if (value.empty()) {
+            addEpsilon(from, to);
+        } else {
+            addBytes(state, to, value.back(), value.back());
+        }
+        return true;
+    }
+
+    // UTF-8 of code points from [first, last], as sequences of byte ranges (the same
+    // way as RE2 or Rust's regex do)
+    bool addCodePoints(int from, int to, uint32_t first, uint32_t last)
+    {
+        static const uint32_t maxOfLength[] = {0x7f, 0x7ff, 0xffff, 0x10ffff};
+        for (uint32_t max : maxOfLength) {
+            if (first <= max && last > max) {
+                return addCodePoints(from, to, first, max) && addCodePoints(from, to, max + 1, last);
+            }
+        }
+        if (last < 0x80) {
+            addBytes(from, to, first, last);
+            return true;
+        }
+        size_t length = utf8Length(first);
+        for (size_t i = 1; i < length; ++i) {
+            uint32_t mask = (uint32_t(1) << (6 * i)) - 1;
+            if ((first & ~mask) != (last & ~mask)) {
+                if ((first & mask) != 0) {
+                    return addCodePoints(from, to, first, first | mask)
+                        && addCodePoints(from, to, (first | mask) + 1, last);
+                }
+                if ((last & mask) != mask) {
+                    return addCodePoints(from, to, first, (last & ~mask) - 1)
+                        && addCodePoints(from, to, last & ~mask, last);
+                }
+            }
+        }
+        std::string firstUtf8, lastUtf8;
+        appendUtf8(firstUtf8, first);
+        appendUtf8(lastUtf8, last);
+        int state = from;
+        for (size_t i = 0; i < length; ++i) {
+            int next = i + 1 == length ? to : addState();
+            if (next < 0) {
+                return false;
+            }
+            addBytes(state, next, firstUtf8[i], lastUtf8[i]);
+            state = next;
+        }
+        return true;
+    }
+};
+
+// Nonnegative number as a mantissa from [0.5, 1) (or 0) times 2 to an exponent of its own,
+// as numbers of strings of a length go way beyond the range of long double (256^2048 does).
+class BigCount
+{
+private:
+    long double _mantissa = 0;
+    int64_t _exponent = 0;
+
+public:
+    BigCount() {}
+
+    BigCount(long double value)
+    {
+        int exponent;
+        _mantissa = std::frexp(value, &exponent);
+        _exponent = exponent;
+    }
+
+    static BigCount power(long double base, size_t n)
+    {
+        BigCount result(1), square(base);
+        for (; n != 0; n >>= 1, square = square * square) {
+            if (n & 1) {
+                result = result * square;
+            }
+        }
+        return result;
+    }
+
+    bool isZero() const
+    {
+        return _mantissa == 0;
+    }
+
+    BigCount operator*(const BigCount &other) const
+    {
+        BigCount result;
+        result._mantissa = _mantissa * other._mantissa;
+        result._exponent = _exponent + other._exponent;
+        if (result._mantissa < 0.5L && result._mantissa != 0) {
+            result._mantissa *= 2;
+            --result._exponent;
+        }
+        return result;
+    }
+
+    BigCount &operator+=(const BigCount &other)
+    {
+        if (other.isZero()) {
+            return *this;
+        }
+        if (isZero() || other._exponent - _exponent > 80) {
+            return *this = other;
+        }
+        if (_exponent - other._exponent <= 80) {
+            _mantissa += std::ldexp(other._mantissa, static_cast<int>(other._exponent - _exponent));
+        }
+        if (_mantissa >= 1) {
+            _mantissa /= 2;
+            ++_exponent;
+        }
+        return *this;
+    }
+
+    BigCount operator+(const BigCount &other) const
+    {
+        BigCount result = *this;
+        return result += other;
+    }
+
+    int64_t exponent() const
+    {
+        return _exponent;
+    }
+
+    // the number divided by 2^exponent, which may overflow or underflow
+    long double scaled(int64_t exponent) const
+    {
+        int64_t shift = std::max<int64_t>(std::min<int64_t>(_exponent - exponent, 20000), -20000);
+        return std::ldexp(_mantissa, static_cast<int>(shift));
+    }
+
+    long double toLongDouble() const
+    {
+        return scaled(0);
+    }
+};
+
+// Numbers of ways to generate strings of lengths from a window (other lengths have
+// none), see LengthCounter.
+struct LengthCounts
+{
+    size_t first = 0;
+    std::vector<BigCount> counts; // of lengths first, first + 1, ...
+
+    size_t end() const
+    {
+        return first + counts.size();
+    }
+
+    BigCount at(size_t length) const
+    {
+        return length >= first && length < end() ? counts[length - first] : BigCount();
+    }
+
+    void add(size_t length, const BigCount &count)
+    {
+        if (counts.empty()) {
+            first = length;
+        } else if (length < first) {
+            counts.insert(counts.begin(), first - length, BigCount());
+            first = length;
+        }
+        if (length >= end()) {
+            counts.resize(length - first + 1);
+        }
+        counts[length - first] += count;
+    }
+
+    void add(const LengthCounts &other)
+    {
+        for (size_t i = 0; i < other.counts.size(); ++i) {
+            add(other.first + i, other.counts[i]);
+        }
+    }
+
+    // of concatenations of strings of a and b, up to maxLength
+    static LengthCounts concatenation(const LengthCounts &a, const LengthCounts &b, size_t maxLength)
+    {
+        LengthCounts result;
+        if (a.counts.empty() || b.counts.empty() || a.first + b.first > maxLength) {
+            return result;
+        }
+        result.first = a.first + b.first;
+        size_t end = std::min(a.end() + b.end() - 1, maxLength + 1);
+        result.counts.resize(end - result.first);
+        for (size_t i = 0; i < a.counts.size() && result.first + i < end; ++i) {
+            if (a.counts[i].isZero()) {
+                continue;
+            }
+            for (size_t j = 0; j < b.counts.size() && result.first + i + j < end; ++j) {
+                result.counts[i + j] += a.counts[i] * b.counts[j];
+            }
+        }
+        return result;
+    }
+};
+
+class SubtreeSharing;
+class IterativeEngine;
+class BoltzmannOracle;
+class BoltzmannWeights;
+class LengthCounter;
+
+class Generator
+{
+public:
+    // Appends a random string to context.output(), recursing into the children.
+    virtual void generate(GenerationContext &context) = 0;
+
+    void generate(std::stringstream &output)
+    {
+        GenerationContext context;
+        generate(context);
+        output << context.output();
+    }
+
+    // The same without recursion: does a single step of the generation and pushes the rest
+    // of the work onto engine's stack. `step` is 0 when the generator is visited for the
+    // first time, otherwise it's whatever the generator has pushed itself with.
+    virtual void expand(IterativeEngine &engine, GenerationContext &context, size_t step) = 0;
+
+    // Generators which generate() and expand() delegate to.
+    virtual void appendChildren(std::vector<Generator *> &children) const = 0;
+
+    // Moves the generator's own children (not the variables it refers to) to `children`,
+    // see destroyChildren().
+    virtual void releaseChildren(std::vector<std::shared_ptr<Generator>> &children) = 0;
+
+    virtual bool isEmpty() = 0;
+
+    // Optimizes the generator itself, its children having been optimized before (see
+    // ConfigFile::optimize()).
+    virtual void optimize() = 0;
+
+    // Makes the generator's own random choice (of an alternative, a character...) follow
+    // `distribution` rather than be uniform; false if it has no such choice.
+    virtual bool setDistribution(const Distribution &distribution) = 0;
+
+    // Short human-readable label, used e.g. by profilers.
+    virtual std::string describe() const = 0;
+
+    // Identifies what the generator generates, provided that its children are already
+    // shared: two generators with equal keys are interchangeable.
+    virtual std::string structuralKey() const = 0;
+
+    // Replaces children by their shared counterparts, see SubtreeSharing.
+    virtual void shareSubtrees(SubtreeSharing &sharing) = 0;
+
+    // Appends what the generator generates to `shape`; false if that depends on random
+    // choices other than picking characters (or is too long, or nested too deeply).
+    virtual bool appendFixedShape(FixedShape &shape, int depth) const = 0;
+
+    // Adds paths for everything the generator generates between the given states of `nfa`;
+    // false if the automaton would get too big or the generator is recursive.
+    virtual bool appendToNfa(Nfa &nfa, int from, int to, int depth) const = 0;
+
+    // Worst case of the generator, given the worst cases of its children (in the order of
+    // appendChildren()).
+    virtual WorstCase worstCase(const std::vector<WorstCase> &children) const = 0;
+
+    // Value of G(x) = sum of x^length over all the ways the generator can generate
+    // something, and of its derivative, at oracle.x(). See BoltzmannSampler.
+    virtual BoltzmannWeight generatingFunction(BoltzmannOracle &oracle) = 0;
+
+    // Sets weights of the generator's own random choices in `weights`, following the
+    // Boltzmann distribution for oracle.x() (children are taken care of separately).
+    virtual void setBoltzmannWeights(BoltzmannOracle &oracle, BoltzmannWeights &weights) const = 0;
+
+    // Numbers of ways the generator can generate strings of every length up to
+    // counter.maxLength(); the counter gives those of the children. See ExactLengthSampler.
+    virtual LengthCounts countLengths(LengthCounter &counter) const = 0;
+
+    // Appends a string of exactly `length` bytes, every way the generator can generate one
+    // being equally likely. `counter` must have counted the generator.
+    virtual void generateOfLength(LengthCounter &counter, GenerationContext &context, size_t length) = 0;
+
+    virtual ~Generator() {}
+};
+
+// Weights of the random choices of generators set by a BoltzmannSampler, kept by the
+// sampler rather than by the generators, which other generators may share.
+class BoltzmannWeights
+{
+public:
+    // an alias table of alternatives (or of counts), or else the ratio of geometric counts
+    struct Choice
+    {
+        AliasTable table;
+        double ratio;
+    };
+
+private:
+    std::unordered_map<const Generator *, Choice> _choices;
+
+public:
+    void set(const Generator *generator, AliasTable table, double ratio = 1)
+    {
+        _choices[generator] = Choice{std::move(table), ratio};
+    }
+
+    // nullptr if the generator's choices aren't weighted
+    const Choice *of(const Generator *generator) const
+    {
+        auto it = _choices.find(generator);
+        return it == _choices.end() ? nullptr : &it->second;
+    }
+
+    void clear()
+    {
+        _choices.clear();
+    }
+};
+
+// Generates without recursion, using an explicit stack of work items preallocated up
+// to a configurable size, so that arbitrarily deep generators can't overflow the call
+// stack. See Generator::expand().
+class IterativeEngine
+{
+private:
+    struct WorkItem
+    {
+        Generator *generator;
+        size_t step;
+    };
+
+    std::vector<WorkItem> _stack;
+    size_t _maxStackSize;
+    bool _overflow = false;
+    bool _budgetExceeded = false;
+    const BoltzmannWeights *_boltzmannWeights = nullptr;
+
+public:
+    explicit IterativeEngine(size_t maxStackSize = 1 << 20)
+        : _maxStackSize(maxStackSize)
+    {
+        _stack.reserve(std::min<size_t>(maxStackSize, 4096));
+    }
+
+    void push(Generator *generator, size_t step = 0)
+    {
+        if (_stack.size() == _maxStackSize) {
+            _overflow = true;
+            return;
+        }
+        _stack.push_back(WorkItem{generator, step});
+    }
+
+    // Returns false if the stack limit or context's budget (maximum output size or node
+    // visits) has been hit, the output is incomplete then.
+    bool run(Generator &generator, GenerationContext &context)
+    {
+        _stack.clear();
+        _overflow = false;
+        _budgetExceeded = false;
+        size_t visits = 0, maxVisits = context.maxNodeVisits();
+        push(&generator);
+        while (!_stack.empty() && !_overflow) {
+            if (context.output().size() > context.maxOutputSize() || visits++ == maxVisits) {
+                _budgetExceeded = true;
+                return false;
+            }
+            WorkItem item = _stack.back();
+            _stack.pop_back();
+            item.generator->expand(*this, context, item.step);
+        }
+        _budgetExceeded = context.output().size() > context.maxOutputSize();
+        return !_overflow && !_budgetExceeded;
+    }
+
+    // Whether the last run() has failed because of context's budget.
+    bool budgetExceeded() const
+    {
+        return _budgetExceeded;
+    }
+
+    // Makes generators' random choices follow `weights` where it has any (nullptr: none).
+    void setBoltzmannWeights(const BoltzmannWeights *weights)
+    {
+        _boltzmannWeights = weights;
+    }
+
+    // Weights of the generator's choice, nullptr if it makes its own.
+    const BoltzmannWeights::Choice *boltzmannChoice(const Generator *generator) const
+    {
+        return _boltzmannWeights == nullptr ? nullptr : _boltzmannWeights->of(generator);
+    }
+};
+
+// Evaluates generating functions of generators at a point x. Named generators (reached
+// through variables) may refer to each other recursively, so their values are found
+// together, as the fixed point of the system of their equations.
+class BoltzmannOracle
+{
+private:
+    double _x = 0;
+    std::unordered_map<Generator *, BoltzmannWeight> _named;
+    std::vector<Generator *> _order;
+
+public:
+    double x() const
+    {
+        return _x;
+    }
+
+    // Current value for a named generator; newly seen ones start at 0 (and are solved
+    // in the following iterations of solve()).
+    BoltzmannWeight named(Generator *generator)
+    {
+        auto it = _named.find(generator);
+        if (it == _named.end()) {
+            _named.insert(std::make_pair(generator, BoltzmannWeight{0, 0}));
+            _order.push_back(generator);
+            return BoltzmannWeight{0, 0};
+        }
+        return it->second;
+    }
+
+    // Solves the equations of `root` and everything it refers to at x. Returns false if
+    // they have no (finite) solution there, i.e. x is beyond the radius of convergence.
+    bool solve(Generator *root, double x, int maxIterations = 10000)
+    {
+        _x = x;
+        _named.clear();
+        _order.clear();
+        named(root);
+
+        for (int iteration = 0; iteration < maxIterations; ++iteration) {
+            bool changed = false;
+            size_t known = _order.size();
+            for (size_t i = 0; i < known; ++i) {
+                Generator *generator = _order[i];
+                BoltzmannWeight weight = generator->generatingFunction(*this);
+                if (!std::isfinite(weight.value) || !std::isfinite(weight.derivative) || weight.value > 1e200) {
+                    return false;
+                }
+                BoltzmannWeight &old = _named[generator];
+                if (std::fabs(weight.value - old.value) > 1e-12 * std::max(1.0, weight.value)
+                        || std::fabs(weight.derivative - old.derivative) > 1e-12 * std::max(1.0, weight.derivative)) {
+                    changed = true;
+                }
+                old = weight;
+            }
+            if (!changed && known == _order.size()) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Counts of lengths of every generator met, see Generator::countLengths(). Only generators
+// which aren't recursive can be counted.
+class LengthCounter
+{
+public:
+    // generators are counted (and then generated) recursively, so only so deep
+    enum { MAX_TABLES = 1 << 16, MAX_DEPTH = 1000 };
+
+private:
+    size_t _maxLength;
+    std::unordered_map<const Generator *, LengthCounts> _counts;
+    std::unordered_map<const Generator *, std::vector<LengthCounts>> _tables;
+    std::vector<const Generator *> _counting;
+    bool _countable = true;
+    std::function<double()> _random;
+    std::vector<BigCount> _weights; // of pick()
+
+public:
+    // `random` gives uniform numbers from [0, 1) for the choices of lengths and alternatives.
+    LengthCounter(size_t maxLength, std::function<double()> random)
+        : _maxLength(maxLength), _random(std::move(random)) {}
+
+    size_t maxLength() const
+    {
+        return _maxLength;
+    }
+
+    // False if a generator has turned out to be recursive, nested too deeply, its tables
+    // too big, or the lengths of what it generates unknown.
+    bool countable() const
+    {
+        return _countable;
+    }
+
+    void setUncountable()
+    {
+        _countable = false;
+    }
+
+    const LengthCounts &of(const Generator *generator)
+    {
+        auto it = _counts.find(generator);
+        if (it != _counts.end()) {
+            return it->second;
+        }
+        if (_counting.size() >= MAX_DEPTH
+                || std::find(_counting.begin(), _counting.end(), generator) != _counting.end()) {
+            _countable = false;
+            static const LengthCounts none;
+            return none;
+        }
+        _counting.push_back(generator);
+        LengthCounts counts = generator->countLengths(*this);
+        _counting.pop_back();
+        return _counts[generator] = std::move(counts);
+    }
+
+    // Whatever else a generator needs to remember, e.g. counts of suffixes of a series.
+    std::vector<LengthCounts> &tables(const Generator *generator)
+    {
+        return _tables[generator];
+    }
+
+    // Index from [0, n) with probability proportional to weight(index), a BigCount: they're
+    // scaled by the biggest one's power of 2 first.
+    template<typename Weight>
+    size_t pick(size_t n, Weight weight)
+    {
+        _weights.resize(n);
+        int64_t most = std::numeric_limits<int64_t>::min();
+        for (size_t i = 0; i < n; ++i) {
+            _weights[i] = weight(i);
+            if (!_weights[i].isZero()) {
+                most = std::max(most, _weights[i].exponent());
+            }
+        }
+        if (most == std::numeric_limits<int64_t>::min()) {
+            most = 0;
+        }
+        long double total = 0;
+        for (size_t i = 0; i < n; ++i) {
+            total += _weights[i].scaled(most);
+        }
+        long double left = _random() * total;
+        size_t last = 0;
+        for (size_t i = 0; i < n; ++i) {
+            long double w = _weights[i].scaled(most);
+            if (w > 0) {
+                if (left < w) {
+                    return i;
+                }
+                left -= w;
+                last = i;
+            }
+        }
+        return last; // rounding errors
+    }
+
+    // Splits `length` among `parts` consecutive strings generated by part(i), weighing each
+    // length of the i-th one by the ways to generate the rest of the length with the parts
+    // after it, rest(i) (which for the last part is 1 way for the empty string), and
+    // generates them.
+    template<typename Part, typename Rest>
+    void generateParts(GenerationContext &context, size_t length, size_t parts, Part part, Rest rest)
+    {
+        Generator *previous = nullptr;
+        const LengthCounts *previousCounts = nullptr;
+        for (size_t i = 0; i < parts; ++i) {
+            Generator *generator = part(i);
+            // repetitions are of the same generator
+            const LengthCounts &counts = generator == previous ? *previousCounts : of(generator);
+            previous = generator;
+            previousCounts = &counts;
+            const LengthCounts &after = rest(i);
+            size_t n = counts.first > length ? 0 : std::min(counts.counts.size(), length - counts.first + 1);
+            // parts of a single length (like characters) need no choice
+            size_t partLength = counts.first;
+            if (n > 1) {
+                partLength += pick(n, [&](size_t j) { return counts.counts[j] * after.at(length - counts.first - j); });
+            }
+            generator->generateOfLength(*this, context, partLength);
+            length -= partLength;
+        }
+    }
+};
+
+// Computes `combine(generator, values of its children)` bottom-up for all the generators
+// reachable from `root`, without recursion, and returns the value of `root`, or `cyclic`
+// if the generators refer to themselves.
+template<typename Value, typename Combine>
+Value foldGenerators(Generator *root, Value cyclic, Combine combine)
+{
+    struct Frame
+    {
+        Generator *generator;
+        std::vector<Generator *> children;
+        size_t next;
+    };
+
+    std::unordered_map<Generator *, std::pair<bool, Value>> values; // false while being computed
+    std::vector<Frame> stack;
+    std::vector<Value> childValues;
+
+    auto enter = [&](Generator *generator) {
+        values[generator].first = false;
+        stack.push_back(Frame{generator, std::vector<Generator *>(), 0});
+        generator->appendChildren(stack.back().children);
+    };
+
+    enter(root);
+    Value result = cyclic;
+    while (!stack.empty()) {
+        Frame &frame = stack.back();
+        if (frame.next < frame.children.size()) {
+            Generator *child = frame.children[frame.next++];
+            auto known = values.find(child);
+            if (known == values.end()) {
+                enter(child);
+            } else if (!known->second.first) {
+                return cyclic;
+            }
+            continue;
+        }
+
+        childValues.clear();
+        for (Generator *child : frame.children) {
+            childValues.push_back(values[child].second);
+        }
+        result = combine(frame.generator, childValues);
+        values[frame.generator] = std::make_pair(true, result);
+        stack.pop_back();
+    }
+    return result;
+}
+
+// Calls `visit(generator)` for all the generators reachable from `root` which aren't in
+// `visited` yet (adding them to it), children before their parents unless the generators
+// refer to themselves, without recursion.
+template<typename Visit>
+void visitGenerators(Generator *root, std::unordered_set<Generator *> &visited, Visit visit)
+{
+    struct Frame
+    {
+        Generator *generator;
+        std::vector<Generator *> children;
+        size_t next;
+    };
+
+    std::vector<Frame> stack;
+    auto enter = [&](Generator *generator) {
+        if (visited.insert(generator).second) {
+            stack.push_back(Frame{generator, std::vector<Generator *>(), 0});
+            generator->appendChildren(stack.back().children);
+        }
+    };
+
+    enter(root);
+    while (!stack.empty()) {
+        Frame &frame = stack.back();
+        if (frame.next < frame.children.size()) {
+            enter(frame.children[frame.next++]);
+            continue;
+        }
+        visit(frame.generator);
+        stack.pop_back();
+    }
+}
+
+// Drops the generator's children, and theirs which nothing else refers to, without
+// recursion: a generator's children are moved out of it before it's destroyed. Called by
+// the destructors of generators which have children.
+inline void destroyChildren(Generator &generator)
+{
+    std::vector<std::shared_ptr<Generator>> children;
+    generator.releaseChildren(children);
+    while (!children.empty()) {
+        std::shared_ptr<Generator> child = std::move(children.back());
+        children.pop_back();
+        if (child.use_count() == 1) {
+            child->releaseChildren(children);
+        }
+    }
+}
+
+// Length of the longest chain of generators starting at `root`, computed without recursion.
+// static_cast<size_t>(-1) if the generators refer to themselves.
+inline size_t generatorDepth(Generator *root)
+{
+    return foldGenerators<size_t>(root, static_cast<size_t>(-1), [](Generator *, const std::vector<size_t> &children) {
+        size_t depth = 1;
+        for (size_t child : children) {
+            depth = std::max(depth, child + 1);
+        }
+        return depth;
+    });
+}
+
+// Longest string `root` can generate and most generators the iterative engine can visit
+// on the way; both unbounded if the generators refer to themselves.
+inline WorstCase worstCase(Generator *root)
+{
+    const size_t unbounded = static_cast<size_t>(-1);
+    return foldGenerators<WorstCase>(root, WorstCase{unbounded, unbounded},
+                                     [](Generator *generator, const std::vector<WorstCase> &children) {
+        return generator->worstCase(children);
+    });
+}
+
+// Hash-consing: merges structurally identical subtrees into single shared generators,
+// turning trees into a DAG. Works bottom-up, so that children of a generator are already
+// shared (and can be identified by address) when its own key is computed.
+class SubtreeSharing
+{
+private:
+    std::unordered_map<std::string, std::shared_ptr<Generator>> _shared;
+    std::unordered_map<const Generator *, std::shared_ptr<Generator>> _visited;
+    size_t _merged = 0;
+    bool _collecting = false; // share() only collects children not shared yet into _collected
+    std::vector<std::shared_ptr<Generator>> _collected;
+
+    std::shared_ptr<Generator> add(const std::shared_ptr<Generator> &generator)
+    {
+        auto inserted = _shared.insert(std::make_pair(generator->structuralKey(), generator));
+        if (!inserted.second) {
+            _merged++;
+        }
+        _visited.insert(std::make_pair(generator.get(), inserted.first->second));
+        return inserted.first->second;
+    }
+
+public:
+    std::shared_ptr<Generator> share(const std::shared_ptr<Generator> &generator)
+    {
+        auto visited = _visited.find(generator.get());
+        if (visited != _visited.end()) {
+            return visited->second;
+        }
+        if (_collecting) {
+            _collected.push_back(generator);
+            return generator;
+        }
+
+        shareChildren(*generator);
+        return add(generator);
+    }
+
+    // Replaces the children of `root` by their shared counterparts, sharing theirs first,
+    // without recursion: shareSubtrees() of every generator is called once to collect its
+    // children which aren't shared yet, and once more when they are.
+    void shareChildren(Generator &root)
+    {
+        struct Frame
+        {
+            Generator *generator;
+            std::shared_ptr<Generator> shared; // null for the root, which isn't shared itself
+            std::vector<std::shared_ptr<Generator>> children;
+            size_t next;
+        };
+
+        std::vector<Frame> stack;
+        auto enter = [&](Generator &generator, const std::shared_ptr<Generator> &shared) {
+            _collecting = true;
+            generator.shareSubtrees(*this);
+            _collecting = false;
+            stack.push_back(Frame{&generator, shared, std::vector<std::shared_ptr<Generator>>(), 0});
+            stack.back().children.swap(_collected);
+        };
+
+        enter(root, nullptr);
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            if (frame.next < frame.children.size()) {
+                std::shared_ptr<Generator> child = frame.children[frame.next++];
+                if (_visited.find(child.get()) == _visited.end()) {
+                    enter(*child, child);
+                }
+                continue;
+            }
+            frame.generator->shareSubtrees(*this);
+            if (frame.shared) {
+                add(frame.shared);
+            }
+            stack.pop_back();
+        }
+    }
+
+    void share(std::vector<std::shared_ptr<Generator>> &generators)
+    {
+        for (auto &generator : generators) {
+            generator = share(generator);
+        }
+    }
+
+    // Number of generators replaced by an identical one so far.
+    size_t merged() const
+    {
+        return _merged;
+    }
+
+    static std::string keyOf(const Generator *generator)
+    {
+        return std::to_string(reinterpret_cast<uintptr_t>(generator));
+    }
+
+    static std::string keyOf(const std::vector<std::shared_ptr<Generator>> &generators)
+    {
+        std::string key;
+        for (auto &generator : generators) {
+            key += keyOf(generator.get()) + ",";
+        }
+        return key;
+    }
+};
+
+// Registry of named generators. Every name is interned once into a small integer
+// (SymbolId) - generators live in a dense vector indexed by it, and names are looked up
+// in an open-addressing hash table. Referring to a name which isn't defined (yet) interns
+// it too, so that generators can refer to each other by id. Apart from that it behaves
+// like the std::map<std::string, std::unique_ptr<Generator>> it replaces: iteration,
+// find() and size() only see defined generators and insert() doesn't overwrite. Unlike
+// the map's, iteration goes by SymbolId, i.e. in the order names were first met, not by name.
+class MapOfGenerators
+{
+public:
+    typedef size_t SymbolId;
+    typedef std::pair<const std::string, std::unique_ptr<Generator>> value_type;
+
+    static const SymbolId npos = static_cast<SymbolId>(-1);
+
+private:
+    typedef std::vector<value_type> Entries;
+
+    // Skips interned names which have no generator.
+    template<typename EntriesIterator, typename Value>
+    class Iterator
+    {
+    private:
+        EntriesIterator _it, _end;
+
+        void skipUndefined()
+        {
+            while (_it != _end && !_it->second) {
+                ++_it;
+            }
+        }
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename std::remove_const<Value>::type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef Value *pointer;
+        typedef Value &reference;
+
+        Iterator(EntriesIterator it, EntriesIterator end)
+            : _it(it), _end(end)
+        {
+            skipUndefined();
+        }
+
+        reference operator*() const { return *_it; }
+        pointer operator->() const { return &*_it; }
+
+        Iterator &operator++()
+        {
+            ++_it;
+            skipUndefined();
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const { return _it == other._it; }
+        bool operator!=(const Iterator &other) const { return _it != other._it; }
+    };
+
+    struct Slot
+    {
+        size_t hash;
+        SymbolId id; // npos for empty slots
+    };
+
+    Entries _entries;
+    std::vector<Slot> _slots;
+    size_t _definedCount = 0;
+
+    static size_t hashOf(const std::string &name)
+    {
+        return std::hash<std::string>()(name);
+    }
+
+    // Index of the slot holding `name`, or of the empty slot where it should go.
+    size_t findSlot(const std::string &name, size_t hash) const
+    {
+        size_t mask = _slots.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+            const Slot &slot = _slots[i];
+            if (slot.id == npos || (slot.hash == hash && _entries[slot.id].first == name)) {
+                return i;
+            }
+        }
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old(std::max<size_t>(16, _slots.size() * 2), Slot{0, npos});
+        old.swap(_slots);
+        for (const Slot &slot : old) {
+            if (slot.id != npos) {
+                _slots[findSlot(_entries[slot.id].first, slot.hash)] = slot;
+            }
+        }
+    }
+
+public:
+    typedef Iterator<Entries::iterator, value_type> iterator;
+    typedef Iterator<Entries::const_iterator, const value_type> const_iterator;
+
+    SymbolId intern(const std::string &name)
+    {
+        if (2 * (_entries.size() + 1) > _slots.size()) {
+            grow();
+        }
+        size_t hash = hashOf(name);
+        Slot &slot = _slots[findSlot(name, hash)];
+        if (slot.id == npos) {
+            slot.hash = hash;
+            slot.id = _entries.size();
+            _entries.push_back(value_type(name, nullptr));
+        }
+        return slot.id;
+    }
+
+    // npos if the name has never been interned.
+    SymbolId lookup(const std::string &name) const
+    {
+        if (_slots.empty()) {
+            return npos;
+        }
+        return _slots[findSlot(name, hashOf(name))].id;
+    }
+
+    // nullptr if the name isn't defined.
+    Generator *get(SymbolId id) const
+    {
+        return _entries[id].second.get();
+    }
+
+    const std::string &name(SymbolId id) const
+    {
+        return _entries[id].first;
+    }
+
+    size_t symbolCount() const
+    {
+        return _entries.size();
+    }
+
+    std::pair<iterator, bool> insert(std::pair<std::string, std::unique_ptr<Generator>> &&entry)
+    {
+        SymbolId id = intern(entry.first);
+        iterator it(_entries.begin() + id, _entries.end());
+        if (_entries[id].second) {
+            return std::make_pair(it, false);
+        }
+        _entries[id].second = std::move(entry.second);
+        _definedCount++;
+        return std::make_pair(iterator(_entries.begin() + id, _entries.end()), true);
+    }
+
+    iterator find(const std::string &name)
+    {
+        SymbolId id = lookup(name);
+        return id == npos || !_entries[id].second ? end() : iterator(_entries.begin() + id, _entries.end());
+    }
+
+    const_iterator find(const std::string &name) const
+    {
+        SymbolId id = lookup(name);
+        return id == npos || !_entries[id].second ? end() : const_iterator(_entries.begin() + id, _entries.end());
+    }
+
+    iterator begin() { return iterator(_entries.begin(), _entries.end()); }
+    iterator end() { return iterator(_entries.end(), _entries.end()); }
+    const_iterator begin() const { return const_iterator(_entries.begin(), _entries.end()); }
+    const_iterator end() const { return const_iterator(_entries.end(), _entries.end()); }
+
+    size_t size() const
+    {
+        return _definedCount;
+    }
+
+    bool empty() const
+    {
+        return _definedCount == 0;
+    }
+};
+
+// Set of characters as sorted, disjoint intervals of code points, with prefix sums for
+// mapping indexes to characters and a bitmap for the membership of single bytes. The
+// intervals are also kept in the order they've been added in (see appendListed()).
+// Characters of Unicode classes are generated in UTF-8, others are just bytes.
+class CharClass
+{
+public:
+    struct Interval
+    {
+        uint32_t from, to; // inclusive
+    };
+
+private:
+    std::vector<Interval> _intervals, _listed;
+    std::vector<size_t> _prefixSums; // characters in the intervals before the i-th one
+    uint64_t _bytes[4] = {0, 0, 0, 0};
+    size_t _size = 0;
+    bool _unicode = false;
+
+public:
+    // Sorts & merges the intervals added so far, and indexes them; to be called once all
+    // of them are added, before the class is queried.
+    void normalize()
+    {
+        std::sort(_intervals.begin(), _intervals.end(), [](const Interval &a, const Interval &b) {
+            return a.from < b.from;
+        });
+        size_t merged = 0;
+        for (size_t i = 0; i < _intervals.size(); ++i) {
+            if (merged > 0 && _intervals[i].from <= static_cast<uint64_t>(_intervals[merged - 1].to) + 1) {
+                _intervals[merged - 1].to = std::max(_intervals[merged - 1].to, _intervals[i].to);
+            } else {
+                _intervals[merged++] = _intervals[i];
+            }
+        }
+        _intervals.resize(merged);
+
+        _prefixSums.clear();
+        _size = 0;
+        std::fill(_bytes, _bytes + 4, 0);
+        for (auto &interval : _intervals) {
+            _prefixSums.push_back(_size);
+            _size += interval.to - interval.from + 1;
+            for (uint32_t c = interval.from; c <= std::min<uint32_t>(interval.to, 255); ++c) {
+                _bytes[c >> 6] |= uint64_t(1) << (c & 63);
+            }
+        }
+    }
+
+    CharClass() {}
+
+    // every byte of `chars`
+    explicit CharClass(const std::string &chars)
+    {
+        for (char c : chars) {
+            _intervals.push_back(Interval{static_cast<unsigned char>(c), static_cast<unsigned char>(c)});
+        }
+        _listed = _intervals;
+        normalize();
+    }
+
+    // Adds characters, see normalize().
+    void add(uint32_t from, uint32_t to)
+    {
+        _intervals.push_back(Interval{from, to});
+        _listed.push_back(Interval{from, to});
+    }
+
+    void add(const CharClass &other)
+    {
+        _intervals.insert(_intervals.end(), other._intervals.begin(), other._intervals.end());
+        _listed.insert(_listed.end(), other._listed.begin(), other._listed.end());
+        _unicode = _unicode || other._unicode;
+    }
+
+    bool isUnicode() const
+    {
+        return _unicode;
+    }
+
+    void setUnicode()
+    {
+        _unicode = true;
+    }
+
+    // Unicode general category like `Lu`, or all the categories starting with a letter
+    // like `L`. Returns an empty class for unknown names.
+    static CharClass unicodeCategory(const std::string &name)
+    {
+        CharClass result;
+        result._unicode = true;
+        for (auto &category : Unicode::categories) {
+            if (name == category.name || (name.size() == 1 && name[0] == category.name[0])) {
+                for (unsigned i = category.first; i < category.first + category.count; ++i) {
+                    result._intervals.push_back(Interval{Unicode::ranges[i].from, Unicode::ranges[i].to});
+                }
+            }
+        }
+        result._listed = result._intervals;
+        result.normalize();
+        return result;
+    }
+
+    // The complement: all the bytes, or all the Unicode scalar values, which aren't in the class.
+    CharClass negated() const
+    {
+        if (!_unicode) {
+            return negated(0, 255);
+        }
+        CharClass withSurrogates(*this);
+        withSurrogates.add(0xd800, 0xdfff);
+        withSurrogates.normalize();
+        CharClass result = withSurrogates.negated(0, 0x10ffff);
+        result._unicode = true;
+        return result;
+    }
+
+    // Characters from [min, max] which aren't in the class.
+    CharClass negated(uint32_t min, uint32_t max) const
+    {
+        CharClass result;
+        uint64_t next = min;
+        for (auto &interval : _intervals) {
+            if (interval.from > next && next <= max) {
+                result._intervals.push_back(Interval{static_cast<uint32_t>(next), std::min(interval.from - 1, max)});
+            }
+            next = std::max<uint64_t>(next, static_cast<uint64_t>(interval.to) + 1);
+        }
+        if (next <= max) {
+            result._intervals.push_back(Interval{static_cast<uint32_t>(next), max});
+        }
+        result._listed = result._intervals;
+        result.normalize();
+        return result;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    // the greatest character, 0 if empty
+    uint32_t max() const
+    {
+        return _intervals.empty() ? 0 : _intervals.back().to;
+    }
+
+    bool contains(uint32_t c) const
+    {
+        if (c < 256) {
+            return (_bytes[c >> 6] >> (c & 63)) & 1;
+        }
+        auto it = std::upper_bound(_intervals.begin(), _intervals.end(), c, [](uint32_t c, const Interval &interval) {
+            return c < interval.from;
+        });
+        return it != _intervals.begin() && c <= (it - 1)->to;
+    }
+
+    // index-th character in the sorted order, index < size()
+    uint32_t at(size_t index) const
+    {
+        size_t i = std::upper_bound(_prefixSums.begin(), _prefixSums.end(), index) - _prefixSums.begin() - 1;
+        return _intervals[i].from + static_cast<uint32_t>(index - _prefixSums[i]);
+    }
+
+    const std::vector<Interval> &intervals() const
+    {
+        return _intervals;
+    }
+
+    // Appends the characters to `chars` (as bytes, so max() has to be below 256) in the
+    // order they've been added in, without repetitions.
+    void appendListed(std::string &chars) const
+    {
+        uint64_t seen[4] = {0, 0, 0, 0};
+        for (auto &interval : _listed) {
+            for (uint32_t c = interval.from; c <= interval.to; ++c) {
+                if (!((seen[c >> 6] >> (c & 63)) & 1)) {
+                    seen[c >> 6] |= uint64_t(1) << (c & 63);
+                    chars += static_cast<char>(c);
+                }
+            }
+        }
+    }
+
+    // like `a-z0-9`, with non-printable characters escaped
+    std::string describe() const
+    {
+        std::string result;
+        auto append = [&result](uint32_t c) {
+            if (c >= 0x20 && c < 0x7f) {
+                result += static_cast<char>(c);
+            } else {
+                char escaped[16];
+                snprintf(escaped, sizeof(escaped), c < 256 ? "\\x%02x" : "\\u{%x}", c);
+                result += escaped;
+            }
+        };
+        for (auto &interval : _intervals) {
+            append(interval.from);
+            if (interval.to != interval.from) {
+                result += '-';
+                append(interval.to);
+            }
+        }
+        return result;
+    }
+};
+
+class ConstGenerator : public Generator
+{
+private:
+    std::string _value;
+public:
+    ConstGenerator(const std::string &value)
+        : _value(value) {}
+
+    void generate(GenerationContext &context)
+    {
+        context.output() += _value;
+    }
+
+    void expand(IterativeEngine &, GenerationContext &context, size_t)
+    {
+        generate(context);
+    }
+
+    void appendChildren(std::vector<Generator *> &) const {}
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &) {}
+
+    bool isEmpty()
+    {
+        return _value.size() == 0;
+    }
+
+    void optimize() {}
+
+    bool setDistribution(const Distribution &)
+    {
+        return false;
+    }
+
+    std::string describe() const
+    {
+        return "\"" + (_value.size() > 32 ? _value.substr(0, 29) + "..." : _value) + "\"";
+    }
+
+    std::string structuralKey() const
+    {
+        return "const:" + _value;
+    }
+
+    void shareSubtrees(SubtreeSharing &) {}
+
+    bool appendFixedShape(FixedShape &shape, int) const
+    {
+        return shape.appendConstant(_value);
+    }
+
+    bool appendToNfa(Nfa &nfa, int from, int to, int) const
+    {
+        return nfa.addString(from, to, _value);
+    }
+
+    WorstCase worstCase(const std::vector<WorstCase> &) const
+    {
+        return WorstCase{_value.size(), 1};
+    }
+
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        double length = _value.size();
+        return BoltzmannWeight{std::pow(oracle.x(), length),
+                               length == 0 ? 0 : length * std::pow(oracle.x(), length - 1)};
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &, BoltzmannWeights &) const {}
+
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        LengthCounts counts;
+        if (_value.size() <= counter.maxLength()) {
+            counts.add(_value.size(), 1);
+        }
+        return counts;
+    }
+
+    void generateOfLength(LengthCounter &, GenerationContext &context, size_t)
+    {
+        generate(context);
+    }
+};
+
+template<typename RandNumGenerator>
+class CharAlternativeGenerator : public Generator
+{
+private:
+    enum { MAX_FLAT_CODE_POINTS = 4096 };
+
+    CharClass _chars;
+    std::string _table; // all the characters if they're bytes, in the order of the class's definition
+    std::vector<uint32_t> _codePoints; // all the characters of small Unicode classes
+    double _countsByLength[4] = {0, 0, 0, 0}; // characters by the length of their UTF-8
+    RandNumGenerator _randNumGenerator;
+    bool _skewed = false;
+    SkewedIndex _skew; // over the table's or the class's order if _skewed
+
+    size_t pickIndex(size_t size)
+    {
+        if (_skewed) {
+            return static_cast<size_t>(_skew.sample(_randNumGenerator));
+        }
+        return randomBelow(_randNumGenerator, size);
+    }
+public:
+    CharAlternativeGenerator(const std::string &possibleChars)
+        : CharAlternativeGenerator(CharClass(possibleChars)) {}
+
+    // Small classes are picked from a flat table, others by a binary search of the interval.
+    explicit CharAlternativeGenerator(CharClass &&chars) : _chars(std::move(chars))
+    {
+        if (!_chars.isUnicode()) {
+            assert(_chars.max() < 256);
+            _chars.appendListed(_table);
+            _countsByLength[0] = _table.size();
+            return;
+        }
+        for (auto &interval : _chars.intervals()) {
+            for (uint32_t from = interval.from; from <= interval.to; ) {
+                size_t length = utf8Length(from);
+                uint32_t to = std::min<uint32_t>(interval.to, length == 1 ? 0x7f : length == 2 ? 0x7ff : length == 3 ? 0xffff : 0x10ffff);
+                _countsByLength[length - 1] += to - from + 1;
+                from = to + 1;
+            }
+        }
+        if (_chars.size() <= MAX_FLAT_CODE_POINTS) {
+            for (auto &interval : _chars.intervals()) {
+                for (uint32_t c = interval.from; c <= interval.to; ++c) {
+                    _codePoints.push_back(c);
+                }
+            }
+        }
+    }
+
+    // a byte of a byte class
+    char pick()
+    {
+        return _table[pickIndex(_table.size())];
+    }
+
+    uint32_t pickCodePoint()
+    {
+        if (!_codePoints.empty()) {
+            return _codePoints[pickIndex(_codePoints.size())];
+        }
+        return _chars.at(pickIndex(_chars.size()));
+    }
+
+    // a code point whose UTF-8 is `length` bytes long
+    uint32_t pickCodePointOfLength(size_t length)
+    {
+        static const uint32_t firstOfLength[] = {0, 0x80, 0x800, 0x10000}, lastOfLength[] = {0x7f, 0x7ff, 0xffff, 0x10ffff};
+        size_t index = randomBelow(_randNumGenerator, static_cast<size_t>(_countsByLength[length - 1]));
+        for (auto &interval : _chars.intervals()) {
+            uint32_t from = std::max(interval.from, firstOfLength[length - 1]);
+            uint32_t to = std::min(interval.to, lastOfLength[length - 1]);
+            if (from <= to && index <= to - from) {
+                return from + index;
+            }
+            index -= from <= to ? to - from + 1 : 0;
+        }
+        return 0;
+    }
+
+    void generate(GenerationContext &context)
+    {
+        if (!_table.empty()) {
+            context.output() += pick();
+        } else {
+            appendUtf8(context.output(), pickCodePoint());
+        }
+    }
+
+    void expand(IterativeEngine &, GenerationContext &context, size_t)
+    {
+        generate(context);
+    }
+
+    void appendChildren(std::vector<Generator *> &) const {}
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &) {}
+
+    bool isEmpty()
+    {
+        return _chars.empty();
+    }
+
+    void optimize() {}
+
+    bool setDistribution(const Distribution &distribution)
+    {
+        _skewed = distribution.kind != Distribution::UNIFORM;
+        _skew = SkewedIndex(distribution, static_cast<long double>(_chars.size()));
+        return true;
+    }
+
+    std::string describe() const
+    {
+        std::string chars = _chars.describe();
+        return "[" + (chars.size() > 32 ? chars.substr(0, 29) + "..." : chars) + "]";
+    }
+
+    std::string structuralKey() const
+    {
+        // the table's order matters for the random number generators
+        std::string key = _table.empty() ? "unicode:" + _chars.describe() : "chars:" + _table;
+        return _skewed ? key + "~" + _skew.distribution().text : key;
+    }
+
+    void shareSubtrees(SubtreeSharing &) {}
+
+    bool appendFixedShape(FixedShape &shape, int) const
+    {
+        return !_table.empty() && !_skewed && shape.appendPick(_table);
+    }
+
+    bool appendToNfa(Nfa &nfa, int from, int to, int) const
+    {
+        for (auto &interval : _chars.intervals()) {
+            if (!_chars.isUnicode()) {
+                nfa.addBytes(from, to, interval.from, interval.to);
+            } else if (!nfa.addCodePoints(from, to, interval.from, interval.to)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    WorstCase worstCase(const std::vector<WorstCase> &) const
+    {
+        return WorstCase{_chars.isUnicode() ? utf8Length(_chars.max()) : 1, 1};
+    }
+
+    // sum of count * x^length over UTF-8 lengths
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        BoltzmannWeight sum{0, 0};
+        for (int length = 1; length <= 4; ++length) {
+            sum.value += _countsByLength[length - 1] * std::pow(oracle.x(), length);
+            sum.derivative += _countsByLength[length - 1] * length * std::pow(oracle.x(), length - 1);
+        }
+        return sum;
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &, BoltzmannWeights &) const {}
+
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        LengthCounts counts;
+        for (size_t length = 1; length <= 4 && length <= counter.maxLength(); ++length) {
+            if (_countsByLength[length - 1] > 0) {
+                counts.add(length, _countsByLength[length - 1]);
+            }
+        }
+        return counts;
+    }
+
+    void generateOfLength(LengthCounter &, GenerationContext &context, size_t length)
+    {
+        if (!_table.empty() || _countsByLength[length - 1] == _chars.size()) {
+            generate(context);
+        } else {
+            appendUtf8(context.output(), pickCodePointOfLength(length));
+        }
+    }
+};
+
+// `{bytes:16}` or `{bytes:0..1024}`: that many random bytes, any of the 256 values,
+// copied from the random number generator a word at a time.
+template<typename RandNumGenerator>
+class RandomBytesGenerator : public Generator
+{
+private:
+    const size_t _from, _to;
+    RandNumGenerator _randNumGenerator;
+public:
+    RandomBytesGenerator(size_t from, size_t to)
+        : _from(from), _to(to) {}
+
+    // geometric if weighted by a BoltzmannSampler
+    size_t drawLength(const BoltzmannWeights::Choice *boltzmann = nullptr)
+    {
+        if (boltzmann != nullptr) {
+            return randomGeometric(_randNumGenerator, _from, _to, boltzmann->ratio);
+        }
+        return _from + randomBelow(_randNumGenerator, _to - _from + 1);
+    }
+
+    void appendBytes(std::string &output, size_t length)
+    {
+        size_t start = output.size();
+        output.resize(start + length);
+        randomBytes(_randNumGenerator, &output[0] + start, length);
+    }
+
+    void generate(GenerationContext &context)
+    {
+        appendBytes(context.output(), drawLength());
+    }
+
+    // no more than needed to exceed the context's limit
+    void expand(IterativeEngine &engine, GenerationContext &context, size_t)
+    {
+        size_t left = context.maxOutputSize() - std::min(context.maxOutputSize(), context.output().size());
+        appendBytes(context.output(), std::min(drawLength(engine.boltzmannChoice(this)), saturatingAdd(left, 1)));
+    }
+
+    void appendChildren(std::vector<Generator *> &) const {}
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &) {}
+
+    bool isEmpty()
+    {
+        return _to == 0;
+    }
+
+    void optimize() {}
+
+    bool setDistribution(const Distribution &)
+    {
+        return false;
+    }
+
+    std::string describe() const
+    {
+        return "{bytes:" + std::to_string(_from) + ".." + std::to_string(_to) + "}";
+    }
+
+    std::string structuralKey() const
+    {
+        return "bytes:" + std::to_string(_from) + ".." + std::to_string(_to);
+    }
+
+    void shareSubtrees(SubtreeSharing &) {}
+
+    // whole words are copied much faster than single bytes could be picked
+    bool appendFixedShape(FixedShape &, int) const
+    {
+        return false;
+    }
+
+    bool appendToNfa(Nfa &nfa, int from, int to, int) const
+    {
+        if (_to == 0) {
+            nfa.addEpsilon(from, to);
+        }
+        int state = from;
+        for (size_t k = 0; k < _to; ++k) {
+            if (k >= _from) {
+                nfa.addEpsilon(state, to);
+            }
+            int next = k + 1 == _to ? to : nfa.addState();
+            if (next < 0) {
+                return false;
+            }
+            nfa.addBytes(state, next, 0, 0xff);
+            state = next;
+        }
+        return true;
+    }
+
+    WorstCase worstCase(const std::vector<WorstCase> &) const
+    {
+        return WorstCase{_to, 1};
+    }
+
+    // sum of (256x)^k for k in [_from, _to]
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        BoltzmannWeight byte{256 * oracle.x(), 256}, power{1, 0}, sum{0, 0};
+        for (size_t k = 0; k <= _to; ++k) {
+            if (k >= _from) {
+                sum = sum + power;
+                if (byte.value < 1 && power.value < 1e-18 * sum.value && power.derivative < 1e-18 * sum.derivative) {
+                    break;
+                }
+            }
+            power = power * byte;
+            if (!std::isfinite(power.value) || !std::isfinite(power.derivative)) {
+                return power;
+            }
+        }
+        return sum;
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &oracle, BoltzmannWeights &weights) const
+    {
+        weights.set(this, AliasTable(), 256 * oracle.x());
+    }
+
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        LengthCounts counts;
+        for (size_t length = _from; length <= std::min(_to, counter.maxLength()); ++length) {
+            counts.add(length, BigCount::power(256, length));
+        }
+        return counts;
+    }
+
+    void generateOfLength(LengthCounter &, GenerationContext &context, size_t length)
+    {
+        appendBytes(context.output(), length);
+    }
+};
+
+// `{int:1..1000000}`: a random integer of the range, formatted straight into the output.
+// Options may follow the range: `pad=N` zero-pads it to N digits, `hex`, `HEX` or `base=N`
+// (2 to 36) change the base, like in `{int:0..65535,hex,pad=4}`.
+template<typename RandNumGenerator>
+class IntegerGenerator : public Generator
+{
+public:
+    struct Format
+    {
+        unsigned base = 10;
+        size_t pad = 0;
+        bool uppercase = false;
+        size_t decimals = 0; // of fixed-point numbers: 1999 is "19.99" with 2 of them
+        bool skewOffsets = false; // distributions are of the offset from the first value, as of {date}s
+    };
+
+private:
+    // values whose strings are `length` bytes long
+    struct ValueRange
+    {
+        size_t length;
+        int64_t from, to;
+
+        long double size() const
+        {
+            return static_cast<long double>(static_cast<uint64_t>(to) - static_cast<uint64_t>(from)) + 1;
+        }
+    };
+
+    const int64_t _from, _to;
+    const Format _format;
+    std::vector<ValueRange> _ranges; // in increasing order of values
+    RandNumGenerator _randNumGenerator;
+    bool _skewed = false;
+    SkewedIndex _skew; // of the value, if _skewed
+
+    // Adds ranges of the values with magnitudes from [from, to], by their number of digits.
+    void addRanges(uint64_t from, uint64_t to, bool negative)
+    {
+        uint64_t first = 0; // of the values with `digits` digits
+        for (size_t digits = 1; first <= to; ++digits) {
+            uint64_t last = first == 0 ? _format.base - 1 : first > UINT64_MAX / _format.base ? UINT64_MAX
+                                                                                               : first * _format.base - 1;
+            if (last >= from) {
+                uint64_t low = std::max(first, from), high = std::min(last, to);
+                size_t length = std::max(digits, _format.pad) + negative + (_format.decimals != 0);
+                // values are negated magnitudes
+                int64_t a = negative ? static_cast<int64_t>(0 - high) : static_cast<int64_t>(low);
+                int64_t b = negative ? static_cast<int64_t>(0 - low) : static_cast<int64_t>(high);
+                _ranges.push_back(ValueRange{length, a, b});
+            }
+            if (last == UINT64_MAX) {
+                break;
+            }
+            first = last + 1;
+        }
+    }
+
+    // padded so that there's a digit before the point
+    static Format withPoint(Format format)
+    {
+        if (format.decimals != 0) {
+            format.pad = std::max(format.pad, format.decimals + 1);
+        }
+        return format;
+    }
+
+    void append(std::string &output, int64_t value) const
+    {
+        appendSigned(output, value, _format.base, _format.pad, _format.uppercase);
+        if (_format.decimals != 0) {
+            output.insert(output.end() - _format.decimals, '.');
+        }
+    }
+
+    int64_t drawValue()
+    {
+        uint64_t n = static_cast<uint64_t>(_to) - static_cast<uint64_t>(_from) + 1;
+        uint64_t index = _skewed ? static_cast<uint64_t>(_skew.sample(_randNumGenerator))
+                                 : randomBelow64(_randNumGenerator, n);
+        return static_cast<int64_t>(static_cast<uint64_t>(_from) + index);
+    }
+
+    bool addDigits(Nfa &nfa, int from, int to, uint64_t low, uint64_t high) const
+    {
+        const char *symbols = _format.uppercase ? "ABCDEFGHIJKLMNOPQRSTUVWXYZ" : "abcdefghijklmnopqrstuvwxyz";
+        if (low <= 9) {
+            nfa.addBytes(from, to, '0' + low, '0' + std::min<uint64_t>(high, 9));
+        }
+        if (high >= 10) {
+            nfa.addBytes(from, to, symbols[std::max<uint64_t>(low, 10) - 10], symbols[high - 10]);
+        }
+        return true;
+    }
+
+    // The point before the first of the decimals, `width` digits being left.
+    bool addPoint(Nfa &nfa, int &from, size_t width) const
+    {
+        if (_format.decimals == 0 || width != _format.decimals) {
+            return true;
+        }
+        int next = nfa.addState();
+        if (next < 0) {
+            return false;
+        }
+        nfa.addBytes(from, next, '.', '.');
+        from = next;
+        return true;
+    }
+
+    // All `width`-digit strings (with leading zeros) of numbers from [low, high].
+    bool appendDigitsToNfa(Nfa &nfa, int from, int to, size_t width, uint64_t low, uint64_t high) const
+    {
+        // leading zeros beyond the digits of high
+        for (; width > digitsInBase(high, _format.base); --width) {
+            int next = nfa.addState();
+            if (next < 0 || !addPoint(nfa, from, width)) {
+                return false;
+            }
+            nfa.addBytes(from, next, '0', '0');
+            from = next;
+        }
+        if (!addPoint(nfa, from, width)) {
+            return false;
+        }
+        uint64_t unit = 1;
+        for (size_t i = 1; i < width; ++i) {
+            unit *= _format.base;
+        }
+        uint64_t first = low / unit, last = high / unit;
+        bool full = low == 0 && last == _format.base - 1 && high - last * unit == unit - 1;
+        if (width == 1 || full || first == last) {
+            // a digit, and the rest
+            int next = width == 1 ? to : nfa.addState();
+            if (next < 0 || !addDigits(nfa, from, next, first, last)) {
+                return false;
+            }
+            return width == 1 || appendDigitsToNfa(nfa, next, to, width - 1, full ? 0 : low % unit,
+                                                   full ? unit - 1 : high % unit);
+        }
+        // the first digit of low, the ones between, and the last digit of high
+        int lowState = nfa.addState(), highState = nfa.addState();
+        if (lowState < 0 || highState < 0 || !addDigits(nfa, from, lowState, first, first)
+                || !appendDigitsToNfa(nfa, lowState, to, width - 1, low % unit, unit - 1)
+                || !addDigits(nfa, from, highState, last, last)
+                || !appendDigitsToNfa(nfa, highState, to, width - 1, 0, high % unit)) {
+            return false;
+        }
+        if (last - first > 1) {
+            int middleState = nfa.addState();
+            return middleState >= 0 && addDigits(nfa, from, middleState, first + 1, last - 1)
+                && appendDigitsToNfa(nfa, middleState, to, width - 1, 0, unit - 1);
+        }
+        return true;
+    }
+
+public:
+    IntegerGenerator(int64_t from, int64_t to, const Format &format) : _from(from), _to(to), _format(withPoint(format))
+    {
+        if (from < 0) {
+            addRanges(to < 0 ? 0 - static_cast<uint64_t>(to) : 1, 0 - static_cast<uint64_t>(from), true);
+            std::reverse(_ranges.begin(), _ranges.end());
+        }
+        if (to >= 0) {
+            addRanges(std::max<int64_t>(from, 0), to, false);
+        }
+    }
+
+    void generate(GenerationContext &context)
+    {
+        append(context.output(), drawValue());
+    }
+
+    void expand(IterativeEngine &, GenerationContext &context, size_t)
+    {
+        generate(context);
+    }
+
+    void appendChildren(std::vector<Generator *> &) const {}
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &) {}
+
+    bool isEmpty()
+    {
+        return false;
+    }
+
+    void optimize() {}
+
+    // of the values themselves, so `{int:0..1000}{~normal:500,100}` is about 500, and
+    // `{float:0..10,precision=2}{~normal:5,1}` about 5.00 (unless _format.skewOffsets)
+    bool setDistribution(const Distribution &distribution)
+    {
+        _skewed = distribution.kind != Distribution::UNIFORM;
+        _skew = SkewedIndex(distribution.scaled(std::pow(10.0, static_cast<double>(_format.decimals))),
+                            static_cast<long double>(static_cast<uint64_t>(_to) - _from) + 1,
+                            _format.skewOffsets ? 0 : _from);
+        return true;
+    }
+
+    std::string describe() const
+    {
+        if (_format.decimals == 0) {
+            return "{int:" + std::to_string(_from) + ".." + std::to_string(_to) + "}";
+        }
+        std::string text = "{float:";
+        append(text, _from);
+        text += "..";
+        append(text, _to);
+        return text + ",precision=" + std::to_string(_format.decimals) + "}";
+    }
+
+    std::string structuralKey() const
+    {
+        return "int:" + std::to_string(_from) + ".." + std::to_string(_to) + "," + std::to_string(_format.base)
+            + "," + std::to_string(_format.pad) + (_format.uppercase ? ",upper" : "")
+            + "," + std::to_string(_format.decimals) + (_format.skewOffsets ? ",offsets" : "")
+            + (_skewed ? "~" + _skew.distribution().text : "");
+    }
+
+    void shareSubtrees(SubtreeSharing &) {}
+
+    bool appendFixedShape(FixedShape &shape, int) const
+    {
+        if (_from != _to) {
+            return false;
+        }
+        std::string value;
+        append(value, _from);
+        return shape.appendConstant(value);
+    }
+
+    bool appendToNfa(Nfa &nfa, int from, int to, int) const
+    {
+        for (auto &range : _ranges) {
+            int state = from;
+            if (range.from < 0) {
+                state = nfa.addState();
+                if (state < 0) {
+                    return false;
+                }
+                nfa.addBytes(from, state, '-', '-');
+            }
+            uint64_t low = range.from < 0 ? 0 - static_cast<uint64_t>(range.to) : range.from;
+            uint64_t high = range.from < 0 ? 0 - static_cast<uint64_t>(range.from) : range.to;
+            size_t width = range.length - (range.from < 0) - (_format.decimals != 0);
+            if (!appendDigitsToNfa(nfa, state, to, width, low, high)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    WorstCase worstCase(const std::vector<WorstCase> &) const
+    {
+        size_t bytes = 0;
+        for (auto &range : _ranges) {
+            bytes = std::max(bytes, range.length);
+        }
+        return WorstCase{bytes, 1};
+    }
+
+    // sum of (values of the length) * x^length
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        BoltzmannWeight sum{0, 0};
+        for (auto &range : _ranges) {
+            double size = static_cast<double>(range.size());
+            sum.value += size * std::pow(oracle.x(), range.length);
+            sum.derivative += size * range.length * std::pow(oracle.x(), range.length - 1.0);
+        }
+        return sum;
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &, BoltzmannWeights &) const {}
+
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        LengthCounts counts;
+        for (auto &range : _ranges) {
+            if (range.length <= counter.maxLength()) {
+                counts.add(range.length, range.size());
+            }
+        }
+        return counts;
+    }
+
+    // uniformly from the values of the length
+    void generateOfLength(LengthCounter &counter, GenerationContext &context, size_t length)
+    {
+        size_t chosen = counter.pick(_ranges.size(), [&](size_t i) {
+            return _ranges[i].length == length ? _ranges[i].size() : 0;
+        });
+        const ValueRange &range = _ranges[chosen];
+        uint64_t n = static_cast<uint64_t>(range.to) - static_cast<uint64_t>(range.from) + 1;
+        append(context.output(), static_cast<int64_t>(static_cast<uint64_t>(range.from)
+                                                      + randomBelow64(_randNumGenerator, n)));
+    }
+};
+
+// Doubles from [from, to), uniform or following a Distribution of their values, in their
+// shortest form (see appendDouble()). Numbers of fixed decimals are IntegerGenerators.
+template<typename RandNumGenerator>
+class FloatGenerator : public Generator
+{
+private:
+    enum { MAX_LENGTH = 25, MAX_ATTEMPTS = 64 };
+
+    const double _from, _to;
+    RandNumGenerator _randNumGenerator;
+    Distribution _distribution;
+    AliasTable _buckets; // of a histogram
+    double _rate = 0, _exponentialMass = 0; // of exponential and geometric distributions
+    size_t _typicalLength;
+
+    double uniform(double from, double to)
+    {
+        double u = static_cast<double>(randomUnit62(_randNumGenerator));
+        double value = std::isinf(to - from) ? from * (1 - u) + to * u : from + u * (to - from);
+        return value < to ? value : from;
+    }
+
+    // the nearest end if the range keeps being missed, the mass being beyond it
+    template<typename Draw>
+    double drawInRange(Draw draw)
+    {
+        double value = _from;
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+            value = draw();
+            if (value >= _from && value < _to) {
+                return value;
+            }
+        }
+        return value < _from || _from == _to ? _from : std::nextafter(_to, _from);
+    }
+
+    double drawValue()
+    {
+        const std::vector<double> &parameters = _distribution.parameters;
+        switch (_distribution.kind) {
+            case Distribution::EXPONENTIAL:
+            case Distribution::GEOMETRIC: {
+                if (_exponentialMass <= 0) {
+                    break;
+                }
+                double u = static_cast<double>(randomUnit62(_randNumGenerator));
+                return std::min(std::nextafter(_to, _from), _from - std::log1p(-u * _exponentialMass) / _rate);
+            }
+            case Distribution::NORMAL:
+                return drawInRange([&] { return parameters[0] + parameters[1] * randomNormal(_randNumGenerator); });
+            case Distribution::LOGNORMAL:
+                return drawInRange([&] { return std::exp(parameters[0] + parameters[1] * randomNormal(_randNumGenerator)); });
+            case Distribution::HISTOGRAM: {
+                double bucket = static_cast<double>(_buckets.sample(randomUnit(_randNumGenerator)));
+                double width = (_to - _from) / _buckets.size();
+                return uniform(_from + bucket * width, std::min(_to, _from + (bucket + 1) * width));
+            }
+            default:
+                break;
+        }
+        return uniform(_from, _to);
+    }
+
+public:
+    FloatGenerator(double from, double to) : _from(from), _to(to)
+    {
+        std::string typical;
+        appendDouble(typical, from + (to - from) * 0.6180339887498949);
+        _typicalLength = typical.size();
+    }
+
+    void generate(GenerationContext &context)
+    {
+        appendDouble(context.output(), drawValue());
+    }
+
+    void expand(IterativeEngine &, GenerationContext &context, size_t)
+    {
+        generate(context);
+    }
+
+    void appendChildren(std::vector<Generator *> &) const {}
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &) {}
+
+    bool isEmpty()
+    {
+        return false;
+    }
+
+    void optimize() {}
+
+    // of the values, as for IntegerGenerator; Zipf's and Poisson's are only for counts
+    bool setDistribution(const Distribution &distribution)
+    {
+        if (distribution.kind == Distribution::ZIPF || distribution.kind == Distribution::POISSON) {
+            return false;
+        }
+        _distribution = distribution;
+        _buckets = distribution.kind == Distribution::HISTOGRAM ? AliasTable(distribution.parameters) : AliasTable();
+        if (distribution.kind == Distribution::EXPONENTIAL || distribution.kind == Distribution::GEOMETRIC) {
+            _rate = distribution.kind == Distribution::EXPONENTIAL ? distribution.parameters[0]
+                                                                    : 1 / distribution.parameters[0];
+            _exponentialMass = -std::expm1(-_rate * (_to - _from));
+        }
+        return true;
+    }
+
+    std::string describe() const
+    {
+        std::string text = "{float:";
+        appendDouble(text, _from);
+        text += "..";
+        appendDouble(text, _to);
+        return text + "}";
+    }
+
+    std::string structuralKey() const
+    {
+        return describe().substr(1) + (_distribution.kind != Distribution::UNIFORM ? "~" + _distribution.text : "");
+    }
+
+    void shareSubtrees(SubtreeSharing &) {}
+
+    bool appendFixedShape(FixedShape &, int) const
+    {
+        return false;
+    }
+
+    // there are too many shortest forms of doubles for an automaton
+    bool appendToNfa(Nfa &, int, int, int) const
+    {
+        return false;
+    }
+
+    WorstCase worstCase(const std::vector<WorstCase> &) const
+    {
+        return WorstCase{MAX_LENGTH, 1};
+    }
+
+    // as if it generated a single string of a typical length
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        double length = static_cast<double>(_typicalLength);
+        return BoltzmannWeight{std::pow(oracle.x(), length), length * std::pow(oracle.x(), length - 1)};
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &, BoltzmannWeights &) const {}
+
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        counter.setUncountable();
+        return LengthCounts();
+    }
+
+    void generateOfLength(LengthCounter &, GenerationContext &context, size_t)
+    {
+        generate(context);
+    }
+};
+
+// Days since 1970-01-01 of a date of the proleptic Gregorian calendar, and back (Howard
+// Hinnant's algorithms, in 400-year eras and years starting in March).
+inline int64_t daysFromCivil(int64_t year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+}
+
+inline void civilFromDays(int64_t days, int64_t &year, unsigned &month, unsigned &day)
+{
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+    unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned shiftedMonth = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2);
+}
+
+// Timestamps (UTC, years 0 to 9999) from a range of days, seconds or milliseconds since
+// 1970-01-01, depending on the format, which is "2024-02-29", "2024-02-29T23:59:59Z",
+// "2024-02-29T23:59:59.999Z", or the number of seconds or milliseconds. Uniform, following
+// a Distribution of how far they are from the first one, or monotonic: the first one,
+// then ones a random step after the previous one (exponentially distributed, with a given
+// mean), staying at the last one once there. The date is only converted from the day when
+// that changes, and digits are written two at a time from digitPairs().
+template<typename RandNumGenerator>
+class DateGenerator : public Generator
+{
+public:
+    enum Format { DATE, ISO, ISO_MILLIS, EPOCH, EPOCH_MILLIS };
+
+private:
+    const int64_t _from, _to; // in units of the format
+    const Format _format;
+    const double _meanStep; // in units, of monotonic timestamps, 0 if they aren't
+    int64_t _last = 0;
+    bool _started = false;
+    RandNumGenerator _randNumGenerator;
+    bool _skewed = false;
+    SkewedIndex _skew; // of the value, if _skewed
+    mutable int64_t _cachedDay = INT64_MIN;
+    mutable char _cachedDate[10]; // of _cachedDay, "YYYY-MM-DD"
+
+    int64_t unitsPerDay() const
+    {
+        return _format == DATE ? 1 : _format == ISO_MILLIS ? 86400000 : 86400;
+    }
+
+    size_t length() const
+    {
+        return _format == DATE ? 10 : _format == ISO ? 20 : 24;
+    }
+
+    static void appendPair(char *where, unsigned value)
+    {
+        memcpy(where, digitPairs() + 2 * value, 2);
+    }
+
+    void append(std::string &output, int64_t value) const
+    {
+        if (_format == EPOCH || _format == EPOCH_MILLIS) {
+            appendSigned(output, value);
+            return;
+        }
+        int64_t perDay = unitsPerDay(), day = value >= 0 ? value / perDay : -((perDay - 1 - value) / perDay);
+        if (day != _cachedDay) {
+            int64_t year;
+            unsigned month, dayOfMonth;
+            civilFromDays(day, year, month, dayOfMonth);
+            appendPair(_cachedDate, static_cast<unsigned>(year / 100));
+            appendPair(_cachedDate + 2, static_cast<unsigned>(year % 100));
+            _cachedDate[4] = _cachedDate[7] = '-';
+            appendPair(_cachedDate + 5, month);
+            appendPair(_cachedDate + 8, dayOfMonth);
+            _cachedDay = day;
+        }
+        size_t start = output.size();
+        output.resize(start + length());
+        char *text = &output[start];
+        memcpy(text, _cachedDate, 10);
+        if (_format == DATE) {
+            return;
+        }
+        unsigned ofDay = static_cast<unsigned>(value - day * perDay);
+        unsigned seconds = _format == ISO_MILLIS ? ofDay / 1000 : ofDay;
+        text[10] = 'T';
+        appendPair(text + 11, seconds / 3600);
+        text[13] = ':';
+        appendPair(text + 14, seconds / 60 % 60);
+        text[16] = ':';
+        appendPair(text + 17, seconds % 60);
+        if (_format == ISO_MILLIS) {
+            text[19] = '.';
+            text[20] = static_cast<char>('0' + ofDay % 1000 / 100);
+            appendPair(text + 21, ofDay % 100);
+        }
+        text[length() - 1] = 'Z';
+    }
+
+    int64_t drawValue()
+    {
+        if (_meanStep > 0) {
+            if (!_started) {
+                _started = true;
+                return _last = _from;
+            }
+            double step = -std::log1p(-static_cast<double>(randomUnit62(_randNumGenerator))) * _meanStep;
+            _last = step + 0.5 >= static_cast<double>(_to - _last) ? _to : _last + static_cast<int64_t>(step + 0.5);
+            return _last;
+        }
+        uint64_t n = static_cast<uint64_t>(_to) - static_cast<uint64_t>(_from) + 1;
+        uint64_t index = _skewed ? static_cast<uint64_t>(_skew.sample(_randNumGenerator))
+                                 : randomBelow64(_randNumGenerator, n);
+        return static_cast<int64_t>(static_cast<uint64_t>(_from) + index);
+    }
+
+public:
+    // Milliseconds in a unit of the format.
+    static int64_t unitOf(Format format)
+    {
+        return format == DATE ? 86400000 : format == ISO || format == EPOCH ? 1000 : 1;
+    }
+
+    DateGenerator(int64_t from, int64_t to, Format format, double meanStep = 0)
+        : _from(from), _to(to), _format(format), _meanStep(meanStep) {}
+
+    void generate(GenerationContext &context)
+    {
+        append(context.output(), drawValue());
+    }
+
+    void expand(IterativeEngine &, GenerationContext &context, size_t)
+    {
+        generate(context);
+    }
+
+    void appendChildren(std::vector<Generator *> &) const {}
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &) {}
+
+    bool isEmpty()
+    {
+        return false;
+    }
+
+    void optimize() {}
+
+    // of the number of units from the first timestamp on, so `{~hist:1,1,1,3}` makes the
+    // last quarter of the range twice as likely as the others
+    bool setDistribution(const Distribution &distribution)
+    {
+        if (_meanStep > 0) {
+            return false;
+        }
+        _skewed = distribution.kind != Distribution::UNIFORM;
+        _skew = SkewedIndex(distribution, static_cast<long double>(static_cast<uint64_t>(_to) - _from) + 1);
+        return true;
+    }
+
+    std::string describe() const
+    {
+        std::string text = "{date:";
+        append(text, _from);
+        text += "..";
+        append(text, _to);
+        return text + "}";
+    }
+
+    // monotonic ones have a state of their own, so they're never shared
+    std::string structuralKey() const
+    {
+        return "date:" + std::to_string(_from) + ".." + std::to_string(_to) + "," + std::to_string(_format)
+            + (_skewed ? "~" + _skew.distribution().text : "")
+            + (_meanStep > 0 ? ",monotonic@" + std::to_string(reinterpret_cast<uintptr_t>(this)) : "");
+    }
+
+    void shareSubtrees(SubtreeSharing &) {}
+
+    bool appendFixedShape(FixedShape &shape, int) const
+    {
+        if (_from != _to) {
+            return false;
+        }
+        std::string value;
+        append(value, _from);
+        return shape.appendConstant(value);
+    }
+
+    // the calendar doesn't make automata of a reasonable size
+    bool appendToNfa(Nfa &, int, int, int) const
+    {
+        return false;
+    }
+
+    WorstCase worstCase(const std::vector<WorstCase> &) const
+    {
+        std::string from, to;
+        append(from, _from);
+        append(to, _to);
+        return WorstCase{std::max(from.size(), to.size()), 1};
+    }
+
+    // as if they were all as long as the last one (which they are unless it's a number)
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        std::string last;
+        append(last, _to);
+        double size = static_cast<double>(static_cast<uint64_t>(_to) - static_cast<uint64_t>(_from)) + 1;
+        double length = static_cast<double>(last.size());
+        return BoltzmannWeight{size * std::pow(oracle.x(), length), size * length * std::pow(oracle.x(), length - 1)};
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &, BoltzmannWeights &) const {}
+
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        LengthCounts counts;
+        if (_format == EPOCH || _format == EPOCH_MILLIS) {
+            counter.setUncountable();
+        } else if (length() <= counter.maxLength()) {
+            counts.add(length(), static_cast<long double>(static_cast<uint64_t>(_to) - static_cast<uint64_t>(_from)) + 1);
+        }
+        return counts;
+    }
+
+    // of the only length there is
+    void generateOfLength(LengthCounter &, GenerationContext &context, size_t)
+    {
+        generate(context);
+    }
+};
+
+class VariableGenerator : public Generator
+{
+private:
+    std::string _varName;
+    const MapOfGenerators *_mapOfGenerators = nullptr;
+    MapOfGenerators::SymbolId _id = MapOfGenerators::npos;
+public:
+    VariableGenerator(std::string &&varName, MapOfGenerators &mapOfGenerators)
+        : _varName(std::move(varName))
+    {
+        link(mapOfGenerators);
+    }
+
+    // Unlinked variable, generates nothing until link() is called.
+    VariableGenerator(std::string &&varName)
+        : _varName(std::move(varName)) {}
+
+    void link(MapOfGenerators &mapOfGenerators)
+    {
+        _mapOfGenerators = &mapOfGenerators;
+        _id = mapOfGenerators.intern(_varName);
+    }
+
+    const std::string &name() const
+    {
+        return _varName;
+    }
+
+    // MapOfGenerators::npos if unlinked
+    MapOfGenerators::SymbolId id() const
+    {
+        return _id;
+    }
+
+    // nullptr if unlinked or undefined
+    Generator *target() const
+    {
+        return _mapOfGenerators == nullptr ? nullptr : _mapOfGenerators->get(_id);
+    }
+
+    void generate(GenerationContext &context)
+    {
+        if (Generator *generator = target()) {
+            generator->generate(context);
+        }
+    }
+
+    void expand(IterativeEngine &engine, GenerationContext &, size_t)
+    {
+        if (Generator *generator = target()) {
+            engine.push(generator);
+        }
+    }
+
+    void appendChildren(std::vector<Generator *> &children) const
+    {
+        if (Generator *generator = target()) {
+            children.push_back(generator);
+        }
+    }
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &) {}
+
+    bool isEmpty()
+    {
+        // TODO
+        return false;
+    }
+
+    void optimize()
+    {
+        // TODO: inline referenced generator
+    }
+
+    bool setDistribution(const Distribution &)
+    {
+        return false;
+    }
+
+    std::string describe() const
+    {
+        return "$" + _varName;
+    }
+
+    std::string structuralKey() const
+    {
+        return "var:" + SubtreeSharing::keyOf(reinterpret_cast<const Generator *>(_mapOfGenerators)) + ":" + _varName;
+    }
+
+    void shareSubtrees(SubtreeSharing &) {}
+
+    bool appendFixedShape(FixedShape &shape, int depth) const
+    {
+        Generator *generator = target();
+        return depth < FixedShape::MAX_DEPTH && (generator == nullptr || generator->appendFixedShape(shape, depth + 1));
+    }
+
+    bool appendToNfa(Nfa &nfa, int from, int to, int depth) const
+    {
+        Generator *generator = target();
+        if (generator == nullptr) {
+            nfa.addEpsilon(from, to);
+            return true;
+        }
+        if (depth >= Nfa::MAX_DEPTH
+                || std::find(nfa.expanding.begin(), nfa.expanding.end(), generator) != nfa.expanding.end()) {
+            return false;
+        }
+        nfa.expanding.push_back(generator);
+        bool appended = generator->appendToNfa(nfa, from, to, depth + 1);
+        nfa.expanding.pop_back();
+        return appended;
+    }
+
+    WorstCase worstCase(const std::vector<WorstCase> &children) const
+    {
+        if (children.empty()) {
+            return WorstCase{0, 1};
+        }
+        return WorstCase{children[0].bytes, saturatingAdd(children[0].nodeVisits, 1)};
+    }
+
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        Generator *generator = target();
+        // undefined variables generate empty strings
+        return generator == nullptr ? BoltzmannWeight{1, 0} : oracle.named(generator);
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &, BoltzmannWeights &) const {}
+
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        Generator *generator = target();
+        if (generator == nullptr) {
+            LengthCounts empty;
+            empty.add(0, 1);
+            return empty;
+        }
+        return counter.of(generator);
+    }
+
+    void generateOfLength(LengthCounter &counter, GenerationContext &context, size_t length)
+    {
+        if (Generator *generator = target()) {
+            generator->generateOfLength(counter, context, length);
+        }
+    }
+};
+
+template<typename RandNumGenerator>
+class RepetitionsGenerator : public Generator
+{
+private:
+    const int _from;
+    int _to;
+    std::shared_ptr<Generator> _generator;
+    RandNumGenerator _randNumGenerator;
+    bool _unbounded = false; // `*` or `+`, bounded by the distribution
+    bool _skewed = false;
+    SkewedIndex _skew; // of the count, if _skewed
+    double _logNormalizer = 0; // makes countWeight() 1 on average
+    bool _constantChild = false; // known after optimize()
+    std::string _constant;
+
+    // Appends `count` copies of _constant by doubling what's been appended so far.
+    void appendConstant(std::string &output, size_t count)
+    {
+        if (_constant.size() == 1) {
+            output.append(count, _constant[0]);
+            return;
+        }
+        size_t start = output.size(), total = _constant.size() * count;
+        if (total == 0) {
+            return;
+        }
+        output.reserve(start + total);
+        output.append(_constant);
+        for (size_t done = _constant.size(); done < total; ) {
+            size_t chunk = std::min(done, total - done);
+            output.append(output.data() + start, chunk);
+            done += chunk;
+        }
+    }
+
+    // relative probability of `count`
+    double countWeight(int count) const
+    {
+        if (!_skewed) {
+            return 1;
+        }
+        return std::exp(_skew.distribution().logWeight(count - _from, _to - _from + 1.0, _from) - _logNormalizer);
+    }
+
+public:
+    enum { UNBOUNDED = -1, MAX_UNBOUNDED_COUNT = 1 << 16, MAX_NORMALIZED_COUNTS = 1 << 20 };
+
+    // `to` may be UNBOUNDED (for `*` and `+`): the count then follows a distribution,
+    // geometric with mean 1 unless set otherwise, up to where its tail gets negligible.
+    RepetitionsGenerator(int from, int to, std::shared_ptr<Generator> &&generator)
+        : _from(from), _to(to), _generator(std::move(generator))
+    {
+        if (to == UNBOUNDED) {
+            _unbounded = true;
+            Distribution geometric;
+            Distribution::parse("geometric:1", geometric);
+            setDistribution(geometric);
+        }
+    }
+
+    ~RepetitionsGenerator()
+    {
+        destroyChildren(*this);
+    }
+
+    // Weighted by a BoltzmannSampler, _from + j has probability proportional to ratio^j (or
+    // follows the table of counts from _from on, for skewed repetitions).
+    int drawCount(const BoltzmannWeights::Choice *boltzmann = nullptr)
+    {
+        if (boltzmann != nullptr && !boltzmann->table.empty()) {
+            return _from + static_cast<int>(boltzmann->table.sample(randomUnit(_randNumGenerator)));
+        }
+        if (boltzmann != nullptr) {
+            return static_cast<int>(randomGeometric(_randNumGenerator, _from, _to, boltzmann->ratio));
+        }
+        if (_skewed) {
+            return _from + static_cast<int>(_skew.sample(_randNumGenerator));
+        }
+        return _from + static_cast<int>(randomBelow(_randNumGenerator, _to - _from + 1));
+    }
+
+    void generate(GenerationContext &context)
+    {
+        int howMany = drawCount();
+        if (_constantChild) {
+            appendConstant(context.output(), howMany);
+            return;
+        }
+        for (int i = 0; i < howMany; i++) {
+            _generator->generate(context);
+        }
+    }
+
+    // step: how many repetitions are still left
+    void expand(IterativeEngine &engine, GenerationContext &context, size_t step)
+    {
+        size_t howMany = step == 0 ? drawCount(engine.boltzmannChoice(this)) : step;
+        if (howMany == 0) {
+            return;
+        }
+        if (_constantChild) {
+            // no more than needed to exceed the context's limit
+            size_t left = context.maxOutputSize() - std::min(context.maxOutputSize(), context.output().size());
+            appendConstant(context.output(), std::min(howMany, _constant.empty() ? 0 : saturatingAdd(left / _constant.size(), 1)));
+            return;
+        }
+        if (howMany > 1) {
+            engine.push(this, howMany - 1);
+        }
+        engine.push(_generator.get());
+    }
+
+    void appendChildren(std::vector<Generator *> &children) const
+    {
+        children.push_back(_generator.get());
+    }
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &children)
+    {
+        children.push_back(std::move(_generator));
+    }
+
+    bool isEmpty()
+    {
+        return _from == 0 && _to == 0;
+    }
+
+    // Repetitions of constants (like `-{10000}`) are then appended with memcpy doubling
+    // instead of one child at a time.
+    void optimize()
+    {
+        FixedShape shape;
+        _constantChild = _generator->appendFixedShape(shape, 0) && shape.picks.empty();
+        _constant = shape.row;
+    }
+
+    bool setDistribution(const Distribution &distribution)
+    {
+        if (_unbounded) {
+            _to = static_cast<int>(std::min<long double>(distribution.upperBound(_from), _from + MAX_UNBOUNDED_COUNT));
+        }
+        _skewed = distribution.kind != Distribution::UNIFORM;
+        _skew = SkewedIndex(distribution, _to - _from + 1.0, _from);
+        if (_skewed) {
+            // log of the average weight of (up to so many) counts
+            int counts = static_cast<int>(std::min<long>(static_cast<long>(_to) - _from + 1, MAX_NORMALIZED_COUNTS));
+            double most = -std::numeric_limits<double>::infinity();
+            for (int k = 0; k < counts; ++k) {
+                most = std::max(most, distribution.logWeight(k, _to - _from + 1.0, _from));
+            }
+            long double sum = 0;
+            for (int k = 0; k < counts && !std::isinf(most); ++k) {
+                sum += std::exp(distribution.logWeight(k, _to - _from + 1.0, _from) - most);
+            }
+            _logNormalizer = std::isinf(most) ? 0 : static_cast<double>(most + std::log(sum / counts));
+        }
+        return true;
+    }
+
+    std::string describe() const
+    {
+        std::string range = "{" + std::to_string(_from) + "," + std::to_string(_to) + "}";
+        return _skewed ? range + "~" + _skew.distribution().text : range;
+    }
+
+    std::string structuralKey() const
+    {
+        return "repetitions:" + std::to_string(_from) + "," + std::to_string(_to)
+            + (_skewed ? "~" + _skew.distribution().text : "") + ":" + SubtreeSharing::keyOf(_generator.get());
+    }
+
+    void shareSubtrees(SubtreeSharing &sharing)
+    {
+        _generator = sharing.share(_generator);
+    }
+
+    bool appendFixedShape(FixedShape &shape, int depth) const
+    {
+        if (_from != _to || depth >= FixedShape::MAX_DEPTH) {
+            return false;
+        }
+        for (int i = 0; i < _to; ++i) {
+            if (++shape.repetitions > FixedShape::MAX_REPETITIONS || !_generator->appendFixedShape(shape, depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool appendToNfa(Nfa &nfa, int from, int to, int depth) const
+    {
+        if (depth >= Nfa::MAX_DEPTH) {
+            return false;
+        }
+        if (_to == 0) {
+            nfa.addEpsilon(from, to);
+        }
+        int state = from;
+        for (int k = 0; k < _to; ++k) {
+            if (k >= _from) {
+                nfa.addEpsilon(state, to);
+            }
+            int next = k + 1 == _to ? to : nfa.addState();
+            if (next < 0 || !_generator->appendToNfa(nfa, state, next, depth + 1)) {
+                return false;
+            }
+            state = next;
+        }
+        return true;
+    }
+
+    // the engine visits the generator itself once per repetition
+    WorstCase worstCase(const std::vector<WorstCase> &children) const
+    {
+        size_t to = _to;
+        return WorstCase{saturatingMultiply(to, children[0].bytes),
+                         saturatingAdd(std::max<size_t>(to, 1), saturatingMultiply(to, children[0].nodeVisits))};
+    }
+
+    // sum of G^k for k in [_from, _to], G being the repeated generator's function
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        BoltzmannWeight child = _generator->generatingFunction(oracle);
+        BoltzmannWeight power{1, 0}, sum{0, 0};
+        for (int k = 0; k <= _to; ++k) {
+            if (k >= _from) {
+                double weight = countWeight(k);
+                sum = sum + BoltzmannWeight{power.value * weight, power.derivative * weight};
+                if (child.value < 1 && power.value * weight < 1e-18 * sum.value
+                        && power.derivative * weight < 1e-18 * sum.derivative) {
+                    break;
+                }
+            }
+            power = power * child;
+            if (!std::isfinite(power.value) || !std::isfinite(power.derivative)) {
+                return power;
+            }
+        }
+        return sum;
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &oracle, BoltzmannWeights &boltzmannWeights) const
+    {
+        double child = _generator->generatingFunction(oracle).value;
+        if (!_skewed) {
+            boltzmannWeights.set(this, AliasTable(), child);
+            return;
+        }
+        // the distribution's weights times child^count, for counts up to where they matter
+        std::vector<double> weights;
+        double most = -std::numeric_limits<double>::infinity();
+        for (int k = _from; k <= _to && k - _from < MAX_UNBOUNDED_COUNT; ++k) {
+            double power = k == 0 ? 0 : k * std::log(child);
+            weights.push_back(std::log(countWeight(k)) + power);
+            most = std::max(most, weights.back());
+        }
+        for (double &weight : weights) {
+            weight = std::isinf(most) ? 0 : std::exp(weight - most);
+        }
+        boltzmannWeights.set(this, AliasTable(weights));
+    }
+
+    // Tables: counts of 0, 1, 2, ... repetitions, as long as there are any short enough.
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        const LengthCounts &child = counter.of(_generator.get());
+        std::vector<LengthCounts> &powers = counter.tables(this);
+        powers.assign(1, LengthCounts());
+        powers[0].add(0, 1);
+        while (static_cast<int>(powers.size()) <= _to && !powers.back().counts.empty()) {
+            if (powers.size() >= LengthCounter::MAX_TABLES) {
+                counter.setUncountable();
+                break;
+            }
+            powers.push_back(LengthCounts::concatenation(powers.back(), child, counter.maxLength()));
+        }
+        LengthCounts counts;
+        for (size_t k = _from; k < powers.size(); ++k) {
+            counts.add(powers[k]);
+        }
+        return counts;
+    }
+
+    void generateOfLength(LengthCounter &counter, GenerationContext &context, size_t length)
+    {
+        std::vector<LengthCounts> &powers = counter.tables(this);
+        size_t counts = powers.size() - std::min<size_t>(_from, powers.size());
+        size_t howMany = _from + counter.pick(counts, [&](size_t k) {
+            return powers[_from + k].at(length) * BigCount(countWeight(static_cast<int>(_from + k)));
+        });
+        Generator *generator = _generator.get();
+        counter.generateParts(context, length, howMany,
+                              [&](size_t) { return generator; },
+                              [&](size_t i) -> const LengthCounts & { return powers[howMany - 1 - i]; });
+    }
+};
+
+class SeriesOfGeneratorsGenerator : public Generator
+{
+private:
+    std::vector<std::shared_ptr<Generator>> _generators;
+public:
+    ~SeriesOfGeneratorsGenerator()
+    {
+        destroyChildren(*this);
+    }
+
+    void swapContents(std::vector<std::shared_ptr<Generator>> &generators)
+    {
+        _generators.swap(generators);
+    }
+
+    // Takes over the generators, leaving `generators` empty.
+    void swapContents(std::vector<std::unique_ptr<Generator>> &generators)
+    {
+        _generators.assign(std::make_move_iterator(generators.begin()), std::make_move_iterator(generators.end()));
+        generators.clear();
+    }
+
+    void generate(GenerationContext &context)
+    {
+        for (auto &generator : _generators) {
+            generator->generate(context);
+        }
+    }
+
+    // step: index of the next generator to run
+    void expand(IterativeEngine &engine, GenerationContext &, size_t step)
+    {
+        if (step < _generators.size()) {
+            if (step + 1 < _generators.size()) {
+                engine.push(this, step + 1);
+            }
+            engine.push(_generators[step].get());
+        }
+    }
+
+    void appendChildren(std::vector<Generator *> &children) const
+    {
+        for (auto &generator : _generators) {
+            children.push_back(generator.get());
+        }
+    }
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &children)
+    {
+        for (auto &generator : _generators) {
+            children.push_back(std::move(generator));
+        }
+        _generators.clear();
+    }
+
+    bool isEmpty()
+    {
+        return _generators.size() == 0;
+    }
+
+    void optimize()
+    {
+        auto emptyBegin = std::stable_partition(_generators.begin(), _generators.end(),
+                                                [](std::shared_ptr<Generator> &gen) {
+            return !gen->isEmpty();
+        });
+
+        _generators.erase(emptyBegin, _generators.end()); 
+    }
+
+    bool setDistribution(const Distribution &)
+    {
+        return false;
+    }
+
+    std::string describe() const
+    {
+        return "series";
+    }
+
+    std::string structuralKey() const
+    {
+        return "series:" + SubtreeSharing::keyOf(_generators);
+    }
+
+    void shareSubtrees(SubtreeSharing &sharing)
+    {
+        sharing.share(_generators);
+    }
+
+    bool appendFixedShape(FixedShape &shape, int depth) const
+    {
+        if (depth >= FixedShape::MAX_DEPTH) {
+            return false;
+        }
+        for (auto &generator : _generators) {
+            if (!generator->appendFixedShape(shape, depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool appendToNfa(Nfa &nfa, int from, int to, int depth) const
+    {
+        if (depth >= Nfa::MAX_DEPTH) {
+            return false;
+        }
+        if (_generators.empty()) {
+            nfa.addEpsilon(from, to);
+        }
+        int state = from;
+        for (size_t i = 0; i < _generators.size(); ++i) {
+            int next = i + 1 == _generators.size() ? to : nfa.addState();
+            if (next < 0 || !_generators[i]->appendToNfa(nfa, state, next, depth + 1)) {
+                return false;
+            }
+            state = next;
+        }
+        return true;
+    }
+
+    // the engine visits the generator itself once per child
+    WorstCase worstCase(const std::vector<WorstCase> &children) const
+    {
+        WorstCase result{0, std::max<size_t>(children.size(), 1)};
+        for (auto &child : children) {
+            result.bytes = saturatingAdd(result.bytes, child.bytes);
+            result.nodeVisits = saturatingAdd(result.nodeVisits, child.nodeVisits);
+        }
+        return result;
+    }
+
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        BoltzmannWeight product{1, 0};
+        for (auto &generator : _generators) {
+            product = product * generator->generatingFunction(oracle);
+        }
+        return product;
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &, BoltzmannWeights &) const {}
+
+    // Tables: counts of every suffix of the series.
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        std::vector<LengthCounts> &suffixes = counter.tables(this);
+        suffixes.assign(_generators.size() + 1, LengthCounts());
+        suffixes.back().add(0, 1);
+        for (size_t i = _generators.size(); i-- > 0; ) {
+            suffixes[i] = LengthCounts::concatenation(counter.of(_generators[i].get()), suffixes[i + 1], counter.maxLength());
+        }
+        return suffixes[0];
+    }
+
+    void generateOfLength(LengthCounter &counter, GenerationContext &context, size_t length)
+    {
+        std::vector<LengthCounts> &suffixes = counter.tables(this);
+        counter.generateParts(context, length, _generators.size(),
+                              [&](size_t i) { return _generators[i].get(); },
+                              [&](size_t i) -> const LengthCounts & { return suffixes[i + 1]; });
+    }
+};
+
+template<typename RandNumGenerator>
+class AlternativeOfGeneratorsGenerator : public Generator
+{
+private:
+    std::vector<std::shared_ptr<Generator>> _generators;
+    RandNumGenerator _randNumGenerator;
+    AliasTable _weights; // uniform choice if empty
+    std::vector<double> _skew; // relative probabilities of a distribution, 1 on average; empty if uniform
+    std::string _distribution;
+
+    double skewOf(size_t i) const
+    {
+        return _skew.empty() ? 1 : _skew[i];
+    }
+public:
+    ~AlternativeOfGeneratorsGenerator()
+    {
+        destroyChildren(*this);
+    }
+
+    void swapContents(std::vector<std::shared_ptr<Generator>> &generators)
+    {
+        _generators.swap(generators);
+    }
+
+    // Takes over the generators, leaving `generators` empty.
+    void swapContents(std::vector<std::unique_ptr<Generator>> &generators)
+    {
+        _generators.assign(std::make_move_iterator(generators.begin()), std::make_move_iterator(generators.end()));
+        generators.clear();
+    }
+
+    // Makes alternatives be chosen with probabilities proportional to `weights`.
+    void setWeights(const std::vector<double> &weights)
+    {
+        assert(weights.size() == _generators.size());
+        _weights = AliasTable(weights);
+    }
+
+    Generator *choose(const BoltzmannWeights::Choice *boltzmann = nullptr)
+    {
+        if (boltzmann != nullptr) {
+            return _generators[boltzmann->table.sample(randomUnit(_randNumGenerator))].get();
+        }
+        if (!_weights.empty()) {
+            return _generators[_weights.sample(randomUnit(_randNumGenerator))].get();
+        }
+        return _generators[randomBelow(_randNumGenerator, _generators.size())].get();
+    }
+
+    void generate(GenerationContext &context)
+    {
+        choose()->generate(context);
+    }
+
+    void expand(IterativeEngine &engine, GenerationContext &, size_t)
+    {
+        engine.push(choose(engine.boltzmannChoice(this)));
+    }
+
+    void appendChildren(std::vector<Generator *> &children) const
+    {
+        for (auto &generator : _generators) {
+            children.push_back(generator.get());
+        }
+    }
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &children)
+    {
+        for (auto &generator : _generators) {
+            children.push_back(std::move(generator));
+        }
+        _generators.clear();
+    }
+
+    bool isEmpty()
+    {
+        return _generators.size() == 0;
+    }
+
+    void optimize()
+    {
+        // TODO: merge single-char alternatives into a CharAlternativeGenerator
+    }
+
+    bool setDistribution(const Distribution &distribution)
+    {
+        _skew = distribution.weights(_generators.size());
+        double sum = std::accumulate(_skew.begin(), _skew.end(), 0.0);
+        if (distribution.kind == Distribution::UNIFORM || !(sum > 0)) {
+            _skew.clear();
+            _distribution.clear();
+            _weights = AliasTable();
+            return true;
+        }
+        for (double &weight : _skew) {
+            weight *= _skew.size() / sum;
+        }
+        _distribution = distribution.text;
+        setWeights(_skew);
+        return true;
+    }
+
+    std::string describe() const
+    {
+        return "alternative";
+    }
+
+    std::string structuralKey() const
+    {
+        return "alternative" + (_distribution.empty() ? "" : "~" + _distribution) + ":"
+            + SubtreeSharing::keyOf(_generators);
+    }
+
+    void shareSubtrees(SubtreeSharing &sharing)
+    {
+        sharing.share(_generators);
+    }
+
+    bool appendFixedShape(FixedShape &shape, int depth) const
+    {
+        return _generators.size() == 1 && depth < FixedShape::MAX_DEPTH
+                && _generators[0]->appendFixedShape(shape, depth + 1);
+    }
+
+    bool appendToNfa(Nfa &nfa, int from, int to, int depth) const
+    {
+        if (depth >= Nfa::MAX_DEPTH) {
+            return false;
+        }
+        if (_generators.empty()) {
+            nfa.addEpsilon(from, to);
+        }
+        for (auto &generator : _generators) {
+            if (!generator->appendToNfa(nfa, from, to, depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    WorstCase worstCase(const std::vector<WorstCase> &children) const
+    {
+        WorstCase result{0, 0};
+        for (auto &child : children) {
+            result.bytes = std::max(result.bytes, child.bytes);
+            result.nodeVisits = std::max(result.nodeVisits, child.nodeVisits);
+        }
+        return WorstCase{result.bytes, saturatingAdd(result.nodeVisits, 1)};
+    }
+
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        BoltzmannWeight sum{0, 0};
+        for (size_t i = 0; i < _generators.size(); ++i) {
+            BoltzmannWeight weight = _generators[i]->generatingFunction(oracle);
+            sum = sum + BoltzmannWeight{weight.value * skewOf(i), weight.derivative * skewOf(i)};
+        }
+        return sum;
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &oracle, BoltzmannWeights &boltzmannWeights) const
+    {
+        std::vector<double> weights;
+        for (size_t i = 0; i < _generators.size(); ++i) {
+            weights.push_back(_generators[i]->generatingFunction(oracle).value * skewOf(i));
+        }
+        boltzmannWeights.set(this, AliasTable(weights));
+    }
+
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        LengthCounts counts;
+        if (_generators.empty()) {
+            counts.add(0, 1);
+        }
+        for (auto &generator : _generators) {
+            counts.add(counter.of(generator.get()));
+        }
+        return counts;
+    }
+
+    void generateOfLength(LengthCounter &counter, GenerationContext &context, size_t length)
+    {
+        if (_generators.empty()) {
+            return;
+        }
+        size_t chosen = counter.pick(_generators.size(), [&](size_t i) {
+            return counter.of(_generators[i].get()).at(length) * BigCount(skewOf(i));
+        });
+        _generators[chosen]->generateOfLength(counter, context, length);
+    }
+};
+
+class PlainRandomNumberGenerator
+{
+public:
+    int get()
+    {
+        return rand();
+    }
+};
+
+// xoshiro256** run on 8 independent lanes at once: with GCC's vector extensions every
+// step of the algorithm is a single vector operation (AVX2/AVX-512 if enabled, SSE2 or
+// scalar code otherwise). Random numbers are produced in blocks into a per-thread buffer
+// shared by all the instances, which generators then consume linearly.
+class XoshiroLanesRandomNumberGenerator
+{
+public:
+    enum { LANES = 8, BLOCK_WORDS = 1024 };
+
+private:
+#if defined(__GNUC__)
+    typedef uint64_t Lanes __attribute__((vector_size(LANES * sizeof(uint64_t))));
+#else
+    struct Lanes
+    {
+        uint64_t lane[LANES];
+    };
+#endif
+
+    struct ThreadState
+    {
+        Lanes state[4];
+        uint32_t buffer[BLOCK_WORDS];
+        size_t position;
+        bool seeded;
+    };
+
+    static ThreadState &threadState()
+    {
+        static thread_local ThreadState state;
+        return state;
+    }
+
+    static uint64_t splitMix64(uint64_t &x)
+    {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+#if defined(__GNUC__)
+    static void setLane(Lanes &lanes, int lane, uint64_t value)
+    {
+        lanes[lane] = value;
+    }
+
+    // One xoshiro256** step of all the lanes. Vectors are passed by reference only, so
+    // that the ABI doesn't depend on the instruction set.
+    static void next(Lanes (&s)[4], Lanes &result)
+    {
+        Lanes times5 = (s[1] << 2) + s[1];
+        Lanes rotated = (times5 << 7) | (times5 >> 57);
+        result = (rotated << 3) + rotated;
+        Lanes t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = (s[3] << 45) | (s[3] >> 19);
+    }
+#else
+    static uint64_t rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    static void setLane(Lanes &lanes, int lane, uint64_t value)
+    {
+        lanes.lane[lane] = value;
+    }
+
+    static void next(Lanes (&s)[4], Lanes &result)
+    {
+        for (int i = 0; i < LANES; ++i) {
+            result.lane[i] = rotl(s[1].lane[i] * 5, 7) * 9;
+            uint64_t t = s[1].lane[i] << 17;
+            s[2].lane[i] ^= s[0].lane[i];
+            s[3].lane[i] ^= s[1].lane[i];
+            s[1].lane[i] ^= s[2].lane[i];
+            s[0].lane[i] ^= s[3].lane[i];
+            s[2].lane[i] ^= t;
+            s[3].lane[i] = rotl(s[3].lane[i], 45);
+        }
+    }
+#endif
+
+    static void refill(ThreadState &state)
+    {
+        if (!state.seeded) {
+            // like PlainRandomNumberGenerator, follow srand() unless seeded explicitly
+            seed((static_cast<uint64_t>(rand()) << 31) ^ rand());
+        }
+        for (size_t i = 0; i < BLOCK_WORDS; i += 2 * LANES) {
+            Lanes words;
+            next(state.state, words);
+            memcpy(state.buffer + i, &words, sizeof(words));
+        }
+        state.position = 0;
+    }
+
+public:
+    // Seeds the current thread's lanes.
+    static void seed(uint64_t seed)
+    {
+        ThreadState &state = threadState();
+        for (int lane = 0; lane < LANES; ++lane) {
+            for (int word = 0; word < 4; ++word) {
+                setLane(state.state[word], lane, splitMix64(seed));
+            }
+        }
+        state.seeded = true;
+        state.position = BLOCK_WORDS;
+    }
+
+    int get()
+    {
+        ThreadState &state = threadState();
+        if (state.position >= BLOCK_WORDS || !state.seeded) {
+            refill(state);
+        }
+        return static_cast<int>(state.buffer[state.position++] >> 1);
+    }
+
+    // 32 random bits per word
+    void fill(uint32_t *words, size_t count)
+    {
+        ThreadState &state = threadState();
+        while (count > 0) {
+            if (state.position >= BLOCK_WORDS || !state.seeded) {
+                refill(state);
+            }
+            size_t n = std::min<size_t>(count, BLOCK_WORDS - state.position);
+            memcpy(words, state.buffer + state.position, n * sizeof(uint32_t));
+            state.position += n;
+            words += n;
+            count -= n;
+        }
+    }
+};
+
+// Bounded choices rarely need all the 31 bits of a get(): picking a digit takes 3.3 bits
+// on average. This policy keeps a number uniformly distributed on [0, _range) and divides
+// every choice out of it, so that the leftover entropy is used by the following choices
+// and Source is called about log2(n) / 31 times per choice from [0, n), exactly uniformly.
+template<typename Source = PlainRandomNumberGenerator>
+class EntropyPoolingRandomNumberGenerator
+{
+private:
+    Source _source;
+    uint64_t _value = 0, _range = 1;
+
+public:
+    int get()
+    {
+        return _source.get();
+    }
+
+    // bulk words pass straight through, if Source has them
+    template<typename S = Source>
+    auto fill(uint32_t *words, size_t count) -> decltype(std::declval<S &>().fill(words, count))
+    {
+        return _source.fill(words, count);
+    }
+
+    // n mustn't be greater than 2^32
+    size_t below(size_t n)
+    {
+        assert(n > 0 && n <= (uint64_t(1) << 32));
+        if (n == 1) {
+            return 0;
+        }
+        for (;;) {
+            while (_range < (uint64_t(1) << 32)) {
+                _value = (_value << 31) | (static_cast<uint64_t>(_source.get()) & 0x7fffffff);
+                _range <<= 31;
+            }
+            uint64_t quotient = _range / n, limit = quotient * n;
+            if (_value < limit) {
+                size_t result = _value % n;
+                _value /= n;
+                _range = quotient;
+                return result;
+            }
+            // what's left above the limit is still uniform, on a smaller range
+            _value -= limit;
+            _range -= limit;
+        }
+    }
+};
+
+// Profiler policy which compiles to nothing: the parser doesn't even wrap
+// the generators when it's used.
+class NullProfiler
+{
+public:
+    static const bool enabled = false;
+};
+
+// Profiler policy which counts invocations, emitted bytes and CPU cycles of every
+// generator, separately for every calling context (i.e. for every path of generators
+// leading to it, named generators included).
+class CycleCountingProfiler
+{
+public:
+    static const bool enabled = true;
+
+    typedef size_t NodeId;
+
+    CycleCountingProfiler()
+        : _contexts(1), _stack(1, 0) {}
+
+    NodeId addNode(const std::string &label)
+    {
+        _labels.push_back(label);
+        return _labels.size() - 1;
+    }
+
+    void enter(NodeId node)
+    {
+        size_t parent = _stack.back();
+        size_t context = 0;
+        for (size_t child : _contexts[parent].children) {
+            if (_contexts[child].node == node) {
+                context = child;
+                break;
+            }
+        }
+        if (context == 0) {
+            context = _contexts.size();
+            _contexts.push_back(Context());
+            _contexts.back().node = node;
+            _contexts[parent].children.push_back(context);
+        }
+        _stack.push_back(context);
+        _starts.push_back(now());
+    }
+
+    void leave(size_t bytes)
+    {
+        uint64_t cycles = now() - _starts.back();
+        _starts.pop_back();
+
+        Context &context = _contexts[_stack.back()];
+        context.invocations++;
+        context.bytes += bytes;
+        context.cycles += cycles;
+        _stack.pop_back();
+        _contexts[_stack.back()].childCycles += cycles;
+    }
+
+    // One line per calling context, indented according to the nesting.
+    void dumpTree(std::ostream &output) const
+    {
+        output << "      cycles        self       calls       bytes  generator" << std::endl;
+        dumpTree(output, 0, 0);
+    }
+
+    // Format understood by flamegraph.pl & co: "outer;inner;innermost self_cycles".
+    void dumpFoldedStacks(std::ostream &output) const
+    {
+        dumpFoldedStacks(output, 0, "");
+    }
+
+private:
+    struct Context
+    {
+        NodeId node = 0;
+        unsigned long invocations = 0, bytes = 0;
+        uint64_t cycles = 0, childCycles = 0;
+        std::vector<size_t> children;
+    };
+
+    std::vector<std::string> _labels;
+    std::vector<Context> _contexts; // _contexts[0] is the root, no generator belongs to it
+    std::vector<size_t> _stack;
+    std::vector<uint64_t> _starts;
+
+    static uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>
+            (std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static uint64_t selfCycles(const Context &context)
+    {
+        return context.cycles > context.childCycles ? context.cycles - context.childCycles : 0;
+    }
+
+    void dumpTree(std::ostream &output, size_t context, int depth) const
+    {
+        for (size_t child : _contexts[context].children) {
+            const Context &c = _contexts[child];
+            char numbers[64];
+            snprintf(numbers, sizeof(numbers), "%12llu%12llu%12lu%12lu  ",
+                     static_cast<unsigned long long>(c.cycles),
+                     static_cast<unsigned long long>(selfCycles(c)), c.invocations, c.bytes);
+            output << numbers << std::string(2 * depth, ' ') << _labels[c.node] << std::endl;
+            dumpTree(output, child, depth + 1);
+        }
+    }
+
+    void dumpFoldedStacks(std::ostream &output, size_t context, const std::string &path) const
+    {
+        for (size_t child : _contexts[context].children) {
+            const Context &c = _contexts[child];
+            std::string label = _labels[c.node];
+            std::replace(label.begin(), label.end(), ';', ':');
+            std::replace(label.begin(), label.end(), '\n', ' ');
+            std::string childPath = path.empty() ? label : path + ";" + label;
+            if (selfCycles(c) > 0) {
+                output << childPath << " " << selfCycles(c) << std::endl;
+            }
+            dumpFoldedStacks(output, child, childPath);
+        }
+    }
+};
+
+template<typename Profiler>
+class ProfilingGenerator : public Generator
+{
+private:
+    std::shared_ptr<Generator> _generator;
+    Profiler &_profiler;
+    typename Profiler::NodeId _node;
+    std::string _label;
+public:
+    ProfilingGenerator(std::shared_ptr<Generator> &&generator, Profiler &profiler, const std::string &label)
+        : _generator(std::move(generator)), _profiler(profiler), _node(profiler.addNode(label)), _label(label) {}
+
+    ~ProfilingGenerator()
+    {
+        destroyChildren(*this);
+    }
+
+    void generate(GenerationContext &context)
+    {
+        size_t before = context.output().size();
+        _profiler.enter(_node);
+        _generator->generate(context);
+        _profiler.leave(context.output().size() - before);
+    }
+
+    // step: 0 on entry, 1 + output size at entry when leaving
+    void expand(IterativeEngine &engine, GenerationContext &context, size_t step)
+    {
+        if (step == 0) {
+            _profiler.enter(_node);
+            engine.push(this, context.output().size() + 1);
+            engine.push(_generator.get());
+        } else {
+            _profiler.leave(context.output().size() - (step - 1));
+        }
+    }
+
+    void appendChildren(std::vector<Generator *> &children) const
+    {
+        children.push_back(_generator.get());
+    }
+
+    void releaseChildren(std::vector<std::shared_ptr<Generator>> &children)
+    {
+        children.push_back(std::move(_generator));
+    }
+
+    bool isEmpty()
+    {
+        return _generator->isEmpty();
+    }
+
+    void optimize() {}
+
+    bool setDistribution(const Distribution &distribution)
+    {
+        return _generator->setDistribution(distribution);
+    }
+
+    std::string describe() const
+    {
+        return _label;
+    }
+
+    std::string structuralKey() const
+    {
+        // every ProfilingGenerator has its own counters, so it's never merged with another
+        return "profiling:" + SubtreeSharing::keyOf(this);
+    }
+
+    void shareSubtrees(SubtreeSharing &sharing)
+    {
+        _generator = sharing.share(_generator);
+    }
+
+    // profiled generators are generated one by one, to be counted
+    bool appendFixedShape(FixedShape &, int) const
+    {
+        return false;
+    }
+
+    bool appendToNfa(Nfa &nfa, int from, int to, int depth) const
+    {
+        return _generator->appendToNfa(nfa, from, to, depth);
+    }
+
+    // entering & leaving
+    WorstCase worstCase(const std::vector<WorstCase> &children) const
+    {
+        return WorstCase{children[0].bytes, saturatingAdd(children[0].nodeVisits, 2)};
+    }
+
+    BoltzmannWeight generatingFunction(BoltzmannOracle &oracle)
+    {
+        return _generator->generatingFunction(oracle);
+    }
+
+    void setBoltzmannWeights(BoltzmannOracle &, BoltzmannWeights &) const {}
+
+    LengthCounts countLengths(LengthCounter &counter) const
+    {
+        return counter.of(_generator.get());
+    }
+
+    void generateOfLength(LengthCounter &counter, GenerationContext &context, size_t length)
+    {
+        size_t before = context.output().size();
+        _profiler.enter(_node);
+        _generator->generateOfLength(counter, context, length);
+        _profiler.leave(context.output().size() - before);
+    }
+};
+
+// Number of strings a generator can generate, saturated at the maximum.
+#if defined(__SIZEOF_INT128__)
+typedef unsigned __int128 LanguageSize;
+#else
+typedef uint64_t LanguageSize;
+#endif
+
+inline std::string formatLanguageSize(LanguageSize size)
+{
+    std::string digits;
+    do {
+        digits += static_cast<char>('0' + static_cast<int>(size % 10));
+        size /= 10;
+    } while (size > 0);
+    return std::string(digits.rbegin(), digits.rend());
+}
+
+// Minimal deterministic automaton accepting exactly the strings a (non-recursive)
+// generator can generate, for validating data. Bytes are mapped to classes that no
+// transition tells apart, and states are numbered premultiplied by the number of the
+// classes, so matching takes a lookup and an addition per byte.
+class Dfa
+{
+public:
+    enum { MAX_STATES = 1 << 16 };
+
+private:
+    unsigned char _byteClasses[256];
+    uint32_t _classCount = 1;
+    uint32_t _start = 0; // state 0 is the dead one
+    std::vector<uint32_t> _transitions{0};
+    std::vector<bool> _accepting{false};
+
+    // bytes from..to all leading to the same live state
+    struct Run
+    {
+        unsigned char from, to;
+        uint32_t target;
+        LanguageSize count; // of strings from the target on
+    };
+
+    std::vector<Run> _runs;
+    std::vector<size_t> _firstRuns{0, 0}; // of every state, and the end
+    std::vector<LanguageSize> _counts{0}; // of strings from every state on
+
+    static LanguageSize addSizes(LanguageSize a, LanguageSize b)
+    {
+        return a + b < a ? ~LanguageSize(0) : a + b;
+    }
+
+    static LanguageSize multiplySizes(LanguageSize a, LanguageSize b)
+    {
+        return b != 0 && a > ~LanguageSize(0) / b ? ~LanguageSize(0) : a * b;
+    }
+
+    // Runs of every state and the numbers of strings, counted from the states of the
+    // longest strings back (the automaton of a generator has no cycles but the dead state's).
+    void countStrings()
+    {
+        const size_t states = _accepting.size();
+        _runs.clear();
+        _firstRuns.assign(1, 0);
+        for (size_t state = 0; state < states; ++state) {
+            for (int byte = 0; byte < 256; ++byte) {
+                uint32_t target = _transitions[state * _classCount + _byteClasses[byte]] / _classCount;
+                if (target == 0) {
+                    continue;
+                }
+                if (_runs.size() > _firstRuns.back() && _runs.back().to + 1 == byte && _runs.back().target == target) {
+                    _runs.back().to = byte;
+                } else {
+                    _runs.push_back(Run{static_cast<unsigned char>(byte), static_cast<unsigned char>(byte), target, 0});
+                }
+            }
+            _firstRuns.push_back(_runs.size());
+        }
+
+        // iterative post-order
+        _counts.assign(states, 0);
+        std::vector<bool> visited(states);
+        std::vector<std::pair<uint32_t, size_t>> stack;
+        visited[0] = true;
+        for (uint32_t root = 0; root < states; ++root) {
+            if (visited[root]) {
+                continue;
+            }
+            visited[root] = true;
+            stack.push_back(std::make_pair(root, _firstRuns[root]));
+            while (!stack.empty()) {
+                uint32_t state = stack.back().first;
+                size_t &run = stack.back().second;
+                if (run < _firstRuns[state + 1]) {
+                    uint32_t target = _runs[run++].target;
+                    if (!visited[target]) {
+                        visited[target] = true;
+                        stack.push_back(std::make_pair(target, _firstRuns[target]));
+                    }
+                    continue;
+                }
+                LanguageSize count = _accepting[state] ? 1 : 0;
+                for (size_t i = _firstRuns[state]; i < _firstRuns[state + 1]; ++i) {
+                    _runs[i].count = _counts[_runs[i].target];
+                    count = addSizes(count, multiplySizes(_runs[i].to - _runs[i].from + 1, _runs[i].count));
+                }
+                _counts[state] = count;
+                stack.pop_back();
+            }
+        }
+    }
+
+    // Epsilon closures of sets of the NFA's states, with the states met marked by the
+    // number of the closure rather than cleared every time.
+    class Closure
+    {
+    private:
+        const Nfa &_nfa;
+        std::vector<uint32_t> _seen;
+        uint32_t _generation = 0;
+        std::vector<int> _stack;
+
+    public:
+        explicit Closure(const Nfa &nfa) : _nfa(nfa), _seen(nfa.states.size(), 0) {}
+
+        // replaces `states` by their closure, sorted
+        void operator()(std::vector<int> &states)
+        {
+            ++_generation;
+            _stack.assign(states.begin(), states.end());
+            states.clear();
+            while (!_stack.empty()) {
+                int state = _stack.back();
+                _stack.pop_back();
+                if (_seen[state] == _generation) {
+                    continue;
+                }
+                _seen[state] = _generation;
+                states.push_back(state);
+                _stack.insert(_stack.end(), _nfa.states[state].epsilons.begin(), _nfa.states[state].epsilons.end());
+            }
+            std::sort(states.begin(), states.end());
+        }
+    };
+
+    // The automaton has no cycles but the dead state's, so states are equivalent if they
+    // are both accepting or not and lead to equivalent states on every byte: states get
+    // their blocks in a single pass, after the states they lead to (in post-order), by
+    // their signatures. State 0 stays the dead one.
+    void minimize(const std::vector<uint32_t> &next, const std::vector<bool> &accepting, uint32_t start)
+    {
+        const size_t states = accepting.size();
+        std::vector<uint32_t> block(states, 0);
+        std::map<std::vector<uint32_t>, uint32_t> signatures;
+        std::vector<uint32_t> signature(_classCount + 1, 0);
+        signature[0] = accepting[0];
+        signatures[signature] = 0;
+        std::vector<bool> visited(states);
+        std::vector<std::pair<uint32_t, uint32_t>> stack; // states and their next classes
+        visited[0] = true;
+        for (uint32_t root = 0; root < states; ++root) {
+            if (visited[root]) {
+                continue;
+            }
+            visited[root] = true;
+            stack.push_back(std::make_pair(root, 0));
+            while (!stack.empty()) {
+                uint32_t state = stack.back().first;
+                uint32_t &c = stack.back().second;
+                if (c < _classCount) {
+                    uint32_t target = next[state * _classCount + c++];
+                    if (!visited[target]) {
+                        visited[target] = true;
+                        stack.push_back(std::make_pair(target, 0));
+                    }
+                    continue;
+                }
+                signature[0] = accepting[state];
+                for (uint32_t k = 0; k < _classCount; ++k) {
+                    signature[k + 1] = block[next[state * _classCount + k]];
+                }
+                block[state] = signatures.insert(std::make_pair(signature, signatures.size())).first->second;
+                stack.pop_back();
+            }
+        }
+
+        size_t blocks = signatures.size();
+        _transitions.assign(blocks * _classCount, 0);
+        _accepting.assign(blocks, false);
+        for (size_t state = 0; state < states; ++state) {
+            for (uint32_t c = 0; c < _classCount; ++c) {
+                _transitions[block[state] * _classCount + c] = block[next[state * _classCount + c]] * _classCount;
+            }
+            _accepting[block[state]] = accepting[state];
+        }
+        _start = block[start] * _classCount;
+    }
+
+    uint32_t run(uint32_t state, const unsigned char *bytes, size_t size) const
+    {
+        for (size_t i = 0; i < size; ++i) {
+            state = _transitions[state + _byteClasses[bytes[i]]];
+        }
+        return state;
+    }
+
+public:
+    // Accepts nothing until compiled.
+    Dfa()
+    {
+        memset(_byteClasses, 0, sizeof(_byteClasses));
+    }
+
+    // Thompson's construction, subset construction and minimization. Returns false (and
+    // leaves the automaton as it was) if the generator is recursive or there would be
+    // too many states.
+    bool compile(const Generator &generator)
+    {
+        Nfa nfa;
+        int start = nfa.addState(), end = nfa.addState();
+        if (!generator.appendToNfa(nfa, start, end, 0)) {
+            return false;
+        }
+
+        bool boundaries[257] = {};
+        for (auto &state : nfa.states) {
+            for (auto &edge : state.edges) {
+                boundaries[edge.from] = boundaries[edge.to + 1] = true;
+            }
+        }
+        unsigned char byteClasses[256];
+        uint32_t classCount = 1;
+        for (int byte = 0; byte < 256; ++byte) {
+            if (byte > 0 && boundaries[byte]) {
+                classCount++;
+            }
+            byteClasses[byte] = classCount - 1;
+        }
+
+        // sets of the NFA's states, the empty one being the dead state
+        std::map<std::vector<int>, uint32_t> ids;
+        std::vector<std::vector<int>> sets(1);
+        std::vector<uint32_t> next;
+        std::vector<bool> accepting;
+        ids[sets[0]] = 0;
+        Closure closure(nfa);
+        std::vector<int> initial{start};
+        closure(initial);
+        ids[initial] = 1;
+        sets.push_back(initial);
+        std::vector<std::vector<int>> targets(classCount);
+        for (size_t current = 0; current < sets.size(); ++current) {
+            for (auto &target : targets) {
+                target.clear();
+            }
+            for (int state : sets[current]) {
+                for (auto &edge : nfa.states[state].edges) {
+                    for (uint32_t c = byteClasses[edge.from]; c <= byteClasses[edge.to]; ++c) {
+                        targets[c].push_back(edge.target);
+                    }
+                }
+            }
+            accepting.push_back(std::binary_search(sets[current].begin(), sets[current].end(), end));
+            for (auto &target : targets) {
+                closure(target);
+                auto found = ids.find(target);
+                if (found == ids.end()) {
+                    if (sets.size() >= MAX_STATES) {
+                        return false;
+                    }
+                    found = ids.insert(std::make_pair(target, sets.size())).first;
+                    sets.push_back(target);
+                }
+                next.push_back(found->second);
+            }
+        }
+
+        memcpy(_byteClasses, byteClasses, sizeof(_byteClasses));
+        _classCount = classCount;
+        minimize(next, accepting, 1);
+        countStrings();
+        return true;
+    }
+
+    // Number of strings the automaton accepts.
+    LanguageSize languageSize() const
+    {
+        return _counts[_start / _classCount];
+    }
+
+    // False if there are too many strings to count (languageSize() is then the maximum),
+    // in which case unrank() isn't reliable either.
+    bool languageSizeExact() const
+    {
+        return languageSize() != ~LanguageSize(0);
+    }
+
+    // The index-th accepted string in the lexicographic (std::string's) order, and the
+    // states it passes through. False if there are fewer strings.
+    bool unrank(LanguageSize index, std::string &string, std::vector<uint32_t> *path = nullptr) const
+    {
+        uint32_t state = _start / _classCount;
+        if (index >= _counts[state]) {
+            return false;
+        }
+        string.clear();
+        if (path) {
+            path->assign(1, state);
+        }
+        for (;;) {
+            if (_accepting[state]) {
+                if (index == 0) {
+                    return true;
+                }
+                index--;
+            }
+            for (size_t i = _firstRuns[state]; i < _firstRuns[state + 1]; ++i) {
+                const Run &run = _runs[i];
+                LanguageSize strings = multiplySizes(run.to - run.from + 1, run.count);
+                if (index < strings) {
+                    string += static_cast<char>(run.from + static_cast<int>(index / run.count));
+                    index %= run.count;
+                    state = run.target;
+                    break;
+                }
+                index -= strings;
+            }
+            if (path) {
+                path->push_back(state);
+            }
+        }
+    }
+
+    // Walks the accepted strings in the lexicographic order, from the one of a given index
+    // on, taking time proportional to the lengths of the strings and no recursion.
+    class Enumerator
+    {
+    private:
+        const Dfa &_dfa;
+        std::string _string;
+        std::vector<uint32_t> _path; // states after every prefix of _string
+        bool _valid;
+
+        // the first live transition from `state` on a byte not less than `byte`
+        const Run *findRun(uint32_t state, int byte) const
+        {
+            for (size_t i = _dfa._firstRuns[state]; i < _dfa._firstRuns[state + 1]; ++i) {
+                if (_dfa._runs[i].to >= byte) {
+                    return &_dfa._runs[i];
+                }
+            }
+            return nullptr;
+        }
+
+    public:
+        Enumerator(const Dfa &dfa, LanguageSize first = 0)
+            : _dfa(dfa), _valid(dfa.unrank(first, _string, &_path)) {}
+
+        bool valid() const
+        {
+            return _valid;
+        }
+
+        const std::string &string() const
+        {
+            return _string;
+        }
+
+        void next()
+        {
+            int byte = 0; // the least byte to extend the string with
+            while (_valid) {
+                const Run *run = findRun(_path.back(), byte);
+                if (run == nullptr) {
+                    if (_string.empty()) {
+                        _valid = false;
+                        break;
+                    }
+                    byte = static_cast<unsigned char>(_string.back()) + 1;
+                    _string.pop_back();
+                    _path.pop_back();
+                    continue;
+                }
+                _string += static_cast<char>(std::max<int>(byte, run->from));
+                _path.push_back(run->target);
+                if (_dfa._accepting[run->target]) {
+                    break;
+                }
+                byte = 0;
+            }
+        }
+    };
+
+    size_t states() const
+    {
+        return _accepting.size();
+    }
+
+    bool match(const char *data, size_t size) const
+    {
+        return _accepting[run(_start, reinterpret_cast<const unsigned char *>(data), size) / _classCount];
+    }
+
+    bool match(const std::string &string) const
+    {
+        return match(string.data(), string.size());
+    }
+
+    // Tells whether each of the strings matches, returns how many do. Strings are matched
+    // four at a time, so that the lookups of one don't wait for the lookups of another.
+    size_t matchMany(const std::string *strings, size_t count, bool *matches) const
+    {
+        size_t i = 0, matched = 0;
+        for (; i + 4 <= count; i += 4) {
+            const unsigned char *bytes[4];
+            uint32_t states[4];
+            size_t common = strings[i].size();
+            for (int k = 0; k < 4; ++k) {
+                bytes[k] = reinterpret_cast<const unsigned char *>(strings[i + k].data());
+                states[k] = _start;
+                common = std::min(common, strings[i + k].size());
+            }
+            for (size_t j = 0; j < common; ++j) {
+                states[0] = _transitions[states[0] + _byteClasses[bytes[0][j]]];
+                states[1] = _transitions[states[1] + _byteClasses[bytes[1][j]]];
+                states[2] = _transitions[states[2] + _byteClasses[bytes[2][j]]];
+                states[3] = _transitions[states[3] + _byteClasses[bytes[3][j]]];
+            }
+            for (int k = 0; k < 4; ++k) {
+                states[k] = run(states[k], bytes[k] + common, strings[i + k].size() - common);
+                matches[i + k] = _accepting[states[k] / _classCount];
+                matched += matches[i + k];
+            }
+        }
+        for (; i < count; ++i) {
+            matches[i] = match(strings[i]);
+            matched += matches[i];
+        }
+        return matched;
+    }
+};
+
+// Draws `count` distinct indexes from [first, last) in increasing order, one at a time and
+// in constant memory, e.g. for Dfa::unrank() to generate strings already sorted. Sparse
+// samples skip to the next index by Vitter's Algorithm D ("An Efficient Algorithm for
+// Sequential Random Sampling", 1987); dense ones, of at least a quarter of the range, are
+// drawn by selection sampling, which visits every index. Both are exact, up to the 64 bits
+// of mantissa of long doubles for ranges bigger than that.
+template<typename RandNumGenerator = PlainRandomNumberGenerator>
+class SortedSample
+{
+private:
+    LanguageSize _first, _next, _last, _left;
+    bool _dense;
+    RandNumGenerator _randNumGenerator;
+
+    long double unit()
+    {
+        return randomUnit62(_randNumGenerator);
+    }
+
+    // How many indexes to skip before the next one taken, out of those left.
+    LanguageSize skip()
+    {
+        LanguageSize most = _last - _next - _left;
+        long double records = static_cast<long double>(_last - _next), n = static_cast<long double>(_left);
+        long double skipped;
+        if (_left == 1) {
+            skipped = std::floor(records * unit());
+        } else {
+            // X is drawn from a density a bit above the skip's, and rejected as Vitter does:
+            // with the cheap bound first, the exact ratio of products only when that fails
+            long double quotient = records - n + 1;
+            for (;;) {
+                long double x;
+                do {
+                    x = records * -std::expm1(std::log(1 - unit()) / n);
+                    skipped = std::floor(x);
+                } while (skipped >= quotient);
+                long double y1 = std::exp(std::log((1 - unit()) * records / quotient) / (n - 1));
+                if (y1 * (1 - x / records) * (quotient / (quotient - skipped)) <= 1) {
+                    break;
+                }
+                long double y2 = 1, top = records - 1, bottom = n - 1 > skipped ? records - n : records - skipped - 1;
+                for (long double steps = std::min(skipped, n - 1); steps > 0; --steps) {
+                    y2 *= top-- / bottom--;
+                }
+                if (records / (records - x) >= y1 * std::exp(std::log(y2) / (n - 1))) {
+                    break;
+                }
+            }
+        }
+        LanguageSize result = static_cast<LanguageSize>(skipped);
+        // long doubles have 64 bits of mantissa, the rest is filled in at random
+        if (records > 1e19L) {
+            result += static_cast<LanguageSize>(unit() * (records / 1.8446744073709551616e19L));
+        }
+        return std::min(result, most);
+    }
+
+public:
+    SortedSample(LanguageSize first, LanguageSize last, LanguageSize count)
+        : _first(std::min(first, last)), _next(_first), _last(last), _left(std::min(count, last - _first)),
+          _dense(_left >= (last - _first) / 4) {}
+
+    // False when all of them have been drawn.
+    bool next(LanguageSize &index)
+    {
+        if (_left == 0) {
+            return false;
+        }
+        if (_dense) {
+            // the next index is taken with probability (indexes to take) / (indexes left)
+            while (unit() * static_cast<long double>(_last - _next) >= static_cast<long double>(_left)) {
+                ++_next;
+            }
+        } else {
+            _next += skip();
+        }
+        index = _next++;
+        _left--;
+        return true;
     }
-
-    void optimize() {}
 };
 
-template<typename RandNumGenerator>
-class CharAlternativeGenerator : public Generator
+// Random strings of a language whose indexes follow a Distribution, with replacement:
+// hot keys for cache and database benchmarks. The ranks the distribution gives are spread
+// over the language by multiplying them by a number coprime with its size and adding an
+// offset (modulo the size), unless `scrambled` is false, so that the hot strings aren't
+// all neighbours.
+template<typename RandNumGenerator = PlainRandomNumberGenerator>
+class SkewedLanguageSample
 {
 private:
-    std::string _possibleChars;
+    LanguageSize _size, _multiplier = 1, _offset = 0;
+    SkewedIndex _index;
     RandNumGenerator _randNumGenerator;
-public:
-    CharAlternativeGenerator(const std::string &possibleChars) : _possibleChars(possibleChars) {}
 
-    void generate(std::stringstream &output)
+    static LanguageSize gcd(LanguageSize a, LanguageSize b)
     {
-        output << _possibleChars[_randNumGenerator.get() % _possibleChars.size()];
+        while (b != 0) {
+            LanguageSize rest = a % b;
+            a = b;
+            b = rest;
+        }
+        return a;
     }
 
-    bool isEmpty()
+    // a * b % _size for a, b < _size, doubling & adding if the product could overflow
+    LanguageSize multiplyModulo(LanguageSize a, LanguageSize b) const
     {
-        return _possibleChars.size() == 0;
+        if (_size <= static_cast<LanguageSize>(1) << (sizeof(LanguageSize) * 4)) {
+            return a * b % _size;
+        }
+        LanguageSize result = 0;
+        for (; b != 0; b >>= 1) {
+            if (b & 1) {
+                result = result >= _size - a ? result - (_size - a) : result + a;
+            }
+            a = a >= _size - a ? a - (_size - a) : a + a;
+        }
+        return result;
     }
 
-    void optimize() {}
+public:
+    SkewedLanguageSample(const Distribution &distribution, LanguageSize size, bool scrambled = true)
+        : _size(size), _index(distribution, static_cast<long double>(size))
+    {
+        if (scrambled && size > 1) {
+            // close to size / golden ratio
+            _multiplier = static_cast<LanguageSize>(static_cast<long double>(size) * 0.6180339887498948482L) % size;
+            while (gcd(_multiplier, size) != 1) {
+                ++_multiplier;
+            }
+            _offset = size / 3;
+        }
+    }
+
+    // size must be above 0
+    LanguageSize next()
+    {
+        LanguageSize rank = std::min(static_cast<LanguageSize>(_index.sample(_randNumGenerator)), _size - 1);
+        LanguageSize index = multiplyModulo(rank, _multiplier);
+        return index >= _size - _offset ? index - (_size - _offset) : index + _offset;
+    }
 };
 
-class VariableGenerator : public Generator
+// Boltzmann sampling: random choices of a generator (and of everything it uses) are
+// weighted so that every string is generated with probability proportional to
+// x^length, where x is tuned for the expected length to hit a target. That keeps
+// recursive grammars like `expr=($num|\($expr\+$expr\))` from exploding, and lengths
+// outside of [minSize, maxSize] are rejected & generated anew.
+class BoltzmannSampler
 {
 private:
-    std::string _varName;
-    const MapOfGenerators &_mapOfGenerators;
+    Generator &_root;
+    size_t _minSize, _maxSize;
+    int _maxAttempts;
+    double _x = 0, _expectedSize = 0;
+    BoltzmannWeights _weights; // of the generators' choices, which stay as they are
+    IterativeEngine _engine;
+
 public:
-    VariableGenerator(std::string &&varName, const MapOfGenerators &mapOfGenerators)
-        : _varName(std::move(varName)), _mapOfGenerators(mapOfGenerators) {}
+    BoltzmannSampler(Generator &root, double expectedSize, size_t minSize = 0,
+                     size_t maxSize = static_cast<size_t>(-1), int maxAttempts = 1000)
+        : _root(root), _minSize(minSize), _maxSize(maxSize), _maxAttempts(maxAttempts)
+    {
+        tune(expectedSize);
+    }
 
-    void generate(std::stringstream &output)
+    // The tuned x; expectedSize() may be less than requested if the generator can't
+    // generate long enough strings.
+    double x() const
     {
-        auto &&it = _mapOfGenerators.find(_varName);
-        if (it != _mapOfGenerators.end()) {
-            it->second->generate(output);
-        }
+        return _x;
     }
 
-    bool isEmpty()
+    double expectedSize() const
     {
-        // TODO
-        return false;
+        return _expectedSize;
     }
 
-    void optimize()
+    // Appends a string of length within [minSize, maxSize] to context.output(); false if
+    // none has been generated in maxAttempts attempts.
+    bool generate(GenerationContext &context)
     {
-        // TODO: inline referenced generator
+        size_t start = context.output().size();
+        size_t maxOutputSize = context.maxOutputSize();
+        context.setMaxOutputSize(_maxSize == static_cast<size_t>(-1) ? maxOutputSize : start + _maxSize);
+
+        bool generated = false;
+        _engine.setBoltzmannWeights(&_weights);
+        for (int attempt = 0; attempt < _maxAttempts && !generated; ++attempt) {
+            context.output().resize(start);
+            generated = _engine.run(_root, context) && context.output().size() - start >= _minSize;
+        }
+        if (!generated) {
+            context.output().resize(start);
+        }
+        context.setMaxOutputSize(maxOutputSize);
+        return generated;
     }
-};
 
-template<typename RandNumGenerator>
-class RepetitionsGenerator : public Generator
-{
 private:
-    const int _from, _to;
-    std::unique_ptr<Generator> _generator;
-    RandNumGenerator _randNumGenerator;
-public:
-    RepetitionsGenerator(int from, int to, std::unique_ptr<Generator> &&generator)
-        : _from(from), _to(to), _generator(std::move(generator)) {}
-    
-    void generate(std::stringstream &output)
+    // Expected length at x, negative if x is beyond the radius of convergence.
+    double expectedSizeAt(BoltzmannOracle &oracle, double x)
     {
-        int howMany = _from + (_randNumGenerator.get() % (_to - _from + 1));
-        for (int i = 0; i < howMany; i++) {
-            _generator->generate(output);
+        if (!oracle.solve(&_root, x)) {
+            return -1;
         }
+        BoltzmannWeight weight = oracle.named(&_root);
+        return weight.value > 0 ? x * weight.derivative / weight.value : 0;
     }
 
-    bool isEmpty()
+    // The expected length grows with x, so x is found by bisection.
+    void tune(double expectedSize)
     {
-        return _from == 0 && _to == 0;
+        BoltzmannOracle oracle;
+        double low = 0, high = 1;
+        for (double size; high < 1e9 && (size = expectedSizeAt(oracle, high)) >= 0 && size < expectedSize; high *= 2) {
+            low = high;
+        }
+        for (int i = 0; i < 64; ++i) {
+            double middle = (low + high) / 2;
+            double size = expectedSizeAt(oracle, middle);
+            if (size >= 0 && size < expectedSize) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+
+        _x = low;
+        _expectedSize = std::max(0.0, expectedSizeAt(oracle, low));
+        applyWeights(oracle);
     }
 
-    void optimize()
+    // Sets weights of every generator reachable from the root, without recursion.
+    void applyWeights(BoltzmannOracle &oracle)
     {
-        // TODO
+        _weights.clear();
+        std::vector<Generator *> stack(1, &_root), children;
+        std::unordered_map<Generator *, bool> visited;
+        visited[&_root] = true;
+        while (!stack.empty()) {
+            Generator *generator = stack.back();
+            stack.pop_back();
+            generator->setBoltzmannWeights(oracle, _weights);
+
+            children.clear();
+            generator->appendChildren(children);
+            for (Generator *child : children) {
+                if (!visited[child]) {
+                    visited[child] = true;
+                    stack.push_back(child);
+                }
+            }
+        }
     }
 };
 
-class SeriesOfGeneratorsGenerator : public Generator
+// Generates strings of lengths within [minLength, maxLength] (e.g. of exactly 128 bytes),
+// every way the generator can generate one being equally likely. The ways to generate
+// every length are counted for every generator up front, and the generation follows the
+// counts top-down, so no string gets thrown away. Recursive generators can't be counted
+// (see BoltzmannSampler for them).
+template<typename RandNumGenerator = PlainRandomNumberGenerator>
+class ExactLengthSampler
 {
 private:
-    std::vector<std::unique_ptr<Generator>> _generators;
+    Generator &_root;
+    size_t _minLength, _maxLength;
+    RandNumGenerator _randNumGenerator;
+    LengthCounter _counter;
+    const LengthCounts &_counts;
+
 public:
-    void swapContents(std::vector<std::unique_ptr<Generator>> &generators)
+    ExactLengthSampler(Generator &root, size_t minLength, size_t maxLength)
+        : _root(root), _minLength(minLength), _maxLength(maxLength),
+          _counter(maxLength, [this]() { return randomUnit(_randNumGenerator); }),
+          _counts(_counter.of(&root)) {}
+
+    ExactLengthSampler(const ExactLengthSampler &) = delete;
+
+    // Number of ways to generate a string of one of the lengths (infinite if it's beyond
+    // long double).
+    long double ways() const
     {
-        _generators.swap(generators);
+        return waysOfLengths().toLongDouble();
     }
 
-    void generate(std::stringstream &output)
+    BigCount waysOfLengths() const
     {
-        for (auto &generator : _generators) {
-            generator->generate(output);
+        BigCount ways;
+        for (size_t length = _minLength; length <= _maxLength; ++length) {
+            ways += _counts.at(length);
         }
+        return ways;
     }
 
-    bool isEmpty()
+    // False if the generator is recursive (or too big or deep to be counted), or it can't generate
+    // strings of such lengths.
+    bool possible() const
     {
-        return _generators.size() == 0;
+        return _counter.countable() && !waysOfLengths().isZero();
     }
 
-    void optimize()
+    // Appends a string to context.output(), unless it's not possible().
+    bool generate(GenerationContext &context)
     {
-        for (auto &gen : _generators) {
-            gen->optimize();
+        if (!possible()) {
+            return false;
         }
-
-        auto emptyBegin = std::stable_partition(_generators.begin(), _generators.end(),
-                                                [](std::unique_ptr<Generator> &gen) {
-            return !gen->isEmpty();
+        size_t length = _minLength + _counter.pick(_maxLength - _minLength + 1, [&](size_t i) {
+            return _counts.at(_minLength + i);
         });
-
-        _generators.erase(emptyBegin, _generators.end()); 
+        _root.generateOfLength(_counter, context, length);
+        return true;
     }
 };
 
-template<typename RandNumGenerator>
-class AlternativeOfGeneratorsGenerator : public Generator
-{
-private:
-    std::vector<std::unique_ptr<Generator>> _generators;
-    RandNumGenerator _randNumGenerator;
-public:
-    void swapContents(std::vector<std::unique_ptr<Generator>> &generators)
-    {
-        _generators.swap(generators);
-    }
+// Wraps generators in ProfilingGenerators, but only if the profiler policy is enabled,
+// so that NullProfiler costs nothing at all.
+template<typename Profiler, bool enabled = Profiler::enabled>
+struct Profiling;
 
-    void generate(std::stringstream &output)
+// Pointer is either std::unique_ptr<Generator> or std::shared_ptr<Generator>.
+template<typename Profiler>
+struct Profiling<Profiler, true>
+{
+    template<typename Pointer>
+    static Pointer wrap(Pointer &&generator, Profiler *profiler, const std::string &label)
     {
-        _generators[_randNumGenerator.get() % _generators.size()]->generate(output);
+        if (profiler == nullptr) {
+            return std::move(generator);
+        }
+        return Pointer(new ProfilingGenerator<Profiler>(std::move(generator), *profiler, label));
     }
 
-    bool isEmpty()
+    template<typename Pointer>
+    static Pointer wrap(Pointer &&generator, Profiler *profiler)
     {
-        return _generators.size() == 0;
+        std::string label = generator->describe();
+        return wrap(std::move(generator), profiler, label);
     }
+};
 
-    void optimize()
+template<typename Profiler>
+struct Profiling<Profiler, false>
+{
+    template<typename Pointer>
+    static Pointer wrap(Pointer &&generator, Profiler *, const std::string &)
     {
-        // TODO
+        return std::move(generator);
     }
-};
 
-class PlainRandomNumberGenerator
-{
-public:
-    int get()
+    template<typename Pointer>
+    static Pointer wrap(Pointer &&generator, Profiler *)
     {
-        return rand();
+        return std::move(generator);
     }
 };
 
 const int EOL = -1;
 
 template<typename FileReader = PlainFileReader,
-         typename RandNumGenerator = PlainRandomNumberGenerator>
+         typename RandNumGenerator = PlainRandomNumberGenerator,
+         typename Profiler = NullProfiler>
 class RegexParser {
 public:
 
     static std::unique_ptr<Generator> parseExpression(const std::string &regex)
     {
-        MapOfGenerators mapOfGenerators;
         RegexParser regexParser;
-        return regexParser.parseRegex(regex, mapOfGenerators, true);
+        return regexParser.parseRegex(regex, nullptr, true);
+    }
+
+    // If Profiler is enabled, all generators are registered in `profiler`. Variables used
+    // by the expression are appended to `variables`, if given. The first error (an invalid
+    // directive or escape sequence, ...) is written to `errMsg`, if given; the generator
+    // then only generates what could be parsed.
+    static std::unique_ptr<Generator> parseExpression(const std::string &regex, MapOfGenerators &generatorsMap,
+                                                      Profiler *profiler = nullptr,
+                                                      std::vector<VariableGenerator *> *variables = nullptr,
+                                                      std::string *errMsg = nullptr)
+    {
+        RegexParser regexParser;
+        regexParser._profiler = profiler;
+        regexParser._variables = variables;
+        auto generator = regexParser.parseRegex(regex, &generatorsMap);
+        regexParser.reportError(errMsg);
+        return generator;
     }
 
-    static std::unique_ptr<Generator> parseExpression(const std::string &regex, const MapOfGenerators &generatorsMap)
+    // Doesn't touch any MapOfGenerators, so it may run concurrently with other parsers:
+    // variables are left unlinked and appended to `unlinkedVariables` instead.
+    static std::unique_ptr<Generator> parseUnlinkedExpression(const std::string &regex,
+                                                              std::vector<VariableGenerator *> &unlinkedVariables,
+                                                              std::string *errMsg = nullptr)
     {
         RegexParser regexParser;
-        return regexParser.parseRegex(regex, generatorsMap);
+        regexParser._variables = &unlinkedVariables;
+        auto generator = regexParser.parseRegex(regex, nullptr);
+        regexParser.reportError(errMsg);
+        return generator;
     }
 
 private:
@@ -247,6 +5593,10 @@ private:
     typedef CharAlternativeGenerator<RandNumGenerator> CharAlternativeGenerator_;
     typedef AlternativeOfGeneratorsGenerator<RandNumGenerator> AlternativeOfGeneratorsGenerator_;
     typedef RepetitionsGenerator<RandNumGenerator> RepetitionsGenerator_;
+    typedef RandomBytesGenerator<RandNumGenerator> RandomBytesGenerator_;
+    typedef IntegerGenerator<RandNumGenerator> IntegerGenerator_;
+    typedef FloatGenerator<RandNumGenerator> FloatGenerator_;
+    typedef DateGenerator<RandNumGenerator> DateGenerator_;
 
     RegexParser() : _generators(2) {}
 
@@ -256,18 +5606,47 @@ private:
         DEFAULT,
         CHAR_ALTERNATIVE, // [abc]
         VARIABLE_NAME, // $foo
-        REPETITIONS_SPECS, // {1,10} or {10}, or {,10}, etc.
+        REPETITIONS_SPECS, // {1,10} or {10}, or {,10}, or {1,}, etc.
         BACKSLASH, // for special characters
+        ESCAPE_SEQUENCE, // \u{1F600}, \u00e9, \p{L}, \pL, \x00, \x{ff}
+        DIRECTIVE, // {bytes:16}, {int:1..100}, or {~zipf:1.2} modifying the previous generator
     };
 
     std::stack<State> _stateStack;
     State _state = DEFAULT;
-    std::vector<std::vector<std::unique_ptr<Generator>>> _generators;
+    // Generators are created shared, so that SubtreeSharing can merge them later on,
+    // only the topmost one is not.
+    std::vector<std::vector<std::shared_ptr<Generator>>> _generators;
+    std::unique_ptr<Generator> _result;
 
     std::stringstream _stream;
     std::vector<int> _repetitions;
+    CharClass _charClass;
+    int _lastClassChar = -1; // the one a `-` may follow, -1 if none
     bool _wasDashInCharAlternative = false;
+    bool _atCharAlternativeStart = false;
+    bool _negatedCharAlternative = false;
+    uint32_t _utf8CodePoint = 0; // of a multi-byte UTF-8 character in a class
+    int _utf8Remaining = 0;
+    std::string _utf8Bytes; // of that character, read so far
+    char _escapeKind = 0;
+    std::string _escape;
     std::vector<std::string> _parseErrors;
+    Profiler *_profiler = nullptr;
+    std::vector<VariableGenerator *> *_variables = nullptr;
+
+    template<typename Pointer>
+    Pointer profiled(Pointer &&generator)
+    {
+        return Profiling<Profiler>::wrap(std::move(generator), _profiler);
+    }
+
+    void reportError(std::string *errMsg) const
+    {
+        if (errMsg != nullptr && !_parseErrors.empty()) {
+            *errMsg = _parseErrors.front();
+        }
+    }
 
     static bool isDigit(int c)
     {
@@ -279,12 +5658,23 @@ private:
         return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || isDigit(c);
     }
 
+    // 1 to 8 hex digits and nothing else (no sign, space or 0x, which strtoul would take)
+    static bool parseHex(const std::string &digits, uint32_t &value)
+    {
+        if (digits.empty() || digits.size() > 8
+                || digits.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            return false;
+        }
+        value = static_cast<uint32_t>(strtoul(digits.c_str(), nullptr, 16));
+        return true;
+    }
+
     template<typename GeneratorType, typename... Rest>
     void pushGenerator(std::stringstream &stream, Rest... otherArgs)
     {
         if (stream.str().size() > 0) {
-            _generators.back().push_back(std::unique_ptr<GeneratorType>
-                    (new GeneratorType(stream.str(), otherArgs...)));
+            _generators.back().push_back(profiled(std::shared_ptr<Generator>
+                    (std::make_shared<GeneratorType>(stream.str(), otherArgs...))));
             stream.str("");
         }
     }
@@ -314,27 +5704,25 @@ private:
             case '(':
                 pushGenerator<ConstGenerator>(_stream);
                 setState(DEFAULT);
-                _generators.push_back(std::vector<std::unique_ptr<Generator>>());
-                _generators.push_back(std::vector<std::unique_ptr<Generator>>());
+                _generators.push_back(std::vector<std::shared_ptr<Generator>>());
+                _generators.push_back(std::vector<std::shared_ptr<Generator>>());
                 break;
             case ')':
                 pushGenerator<ConstGenerator>(_stream);
                 assert(_generators.size() >= 3);
 
                 {
-                    auto seriesGen = std::unique_ptr<SeriesOfGeneratorsGenerator>
-                        (new SeriesOfGeneratorsGenerator());
+                    auto seriesGen = std::make_shared<SeriesOfGeneratorsGenerator>();
                     seriesGen->swapContents(_generators.back());
                     _generators.pop_back();
-                    _generators.back().push_back(std::move(seriesGen));
+                    _generators.back().push_back(profiled(std::shared_ptr<Generator>(std::move(seriesGen))));
                 }
 
                 {
-                    auto altGen = std::unique_ptr<AlternativeOfGeneratorsGenerator_>
-                        (new AlternativeOfGeneratorsGenerator_());
+                    auto altGen = std::make_shared<AlternativeOfGeneratorsGenerator_>();
                     altGen->swapContents(_generators.back());
                     _generators.pop_back();
-                    _generators.back().push_back(std::move(altGen));
+                    _generators.back().push_back(profiled(std::shared_ptr<Generator>(std::move(altGen))));
                 }
                 restoreState();
                 break;
@@ -342,19 +5730,29 @@ private:
                 pushGenerator<ConstGenerator>(_stream);
                 setState(REPETITIONS_SPECS);
                 break;
+            case '*':
+            case '+':
+            case '?':
+                pushGenerator<ConstGenerator>(_stream);
+                pushRepetitions(character == '+' ? 1 : 0, character == '?' ? 1 : RepetitionsGenerator_::UNBOUNDED);
+                break;
             case '[':
                 pushGenerator<ConstGenerator>(_stream);
                 setState(CHAR_ALTERNATIVE);
+                _charClass = CharClass();
+                _lastClassChar = -1;
+                _wasDashInCharAlternative = false;
+                _atCharAlternativeStart = true;
+                _negatedCharAlternative = false;
                 break;
             case '|':
                 pushGenerator<ConstGenerator>(_stream);
 
                 {
-                    auto seriesGen = std::unique_ptr<SeriesOfGeneratorsGenerator>
-                        (new SeriesOfGeneratorsGenerator());
+                    auto seriesGen = std::make_shared<SeriesOfGeneratorsGenerator>();
                     seriesGen->swapContents(_generators.back());
                     assert(_generators.size() >= 2);
-                    (_generators.end() - 2)->push_back(std::move(seriesGen));
+                    (_generators.end() - 2)->push_back(profiled(std::shared_ptr<Generator>(std::move(seriesGen))));
                 }
 
                 break;
@@ -365,18 +5763,17 @@ private:
                 assert(_generators.size() == 2);
 
                 {
-                    auto seriesGen = std::unique_ptr<SeriesOfGeneratorsGenerator>
-                        (new SeriesOfGeneratorsGenerator());
+                    auto seriesGen = std::make_shared<SeriesOfGeneratorsGenerator>();
                     seriesGen->swapContents(_generators.back());
                     _generators.pop_back();
-                    _generators.back().push_back(std::move(seriesGen));
+                    _generators.back().push_back(profiled(std::shared_ptr<Generator>(std::move(seriesGen))));
                 }
 
                 {
                     auto altGen = std::unique_ptr<AlternativeOfGeneratorsGenerator_>
                         (new AlternativeOfGeneratorsGenerator_());
                     altGen->swapContents(_generators.back());
-                    _generators.back().push_back(std::move(altGen));
+                    _result = profiled(std::unique_ptr<Generator>(std::move(altGen)));
                 }
 
                 break;
@@ -386,14 +5783,33 @@ private:
         }
     }
 
+    // of the previous generator
+    void pushRepetitions(int from, int to)
+    {
+        if (_generators.back().empty()) {
+            _parseErrors.push_back("Nothing to repeat");
+            return;
+        }
+        auto prevGenerator = std::move(_generators.back().back());
+        _generators.back().pop_back();
+        _generators.back().push_back(profiled(std::shared_ptr<Generator>
+                (std::make_shared<RepetitionsGenerator_>(from, to, std::move(prevGenerator)))));
+    }
+
     void processCharInRepetitionsSpecsState(int character)
     {
-        if (isDigit(character)) {
+        if (_stream.str().empty() && _repetitions.empty()
+                && ((isAlpha(character) && !isDigit(character)) || character == '~')) {
+            _state = DIRECTIVE;
+            _stream << static_cast<char>(character);
+        } else if (isDigit(character)) {
             _stream << static_cast<char>(character);
         } else {
             assert(character == ',' || character == '}');
 
-            int val = atoi(_stream.str().c_str());
+            // {5,} has no upper bound
+            bool unbounded = _stream.str().empty() && !_repetitions.empty();
+            int val = unbounded ? RepetitionsGenerator_::UNBOUNDED : atoi(_stream.str().c_str());
             _stream.str("");
             _repetitions.push_back(val);
 
@@ -403,63 +5819,531 @@ private:
                     _repetitions.push_back(_repetitions.front());
                 }
 
-                assert(_generators.back().size() > 0);
+                pushRepetitions(_repetitions[0], _repetitions[1]);
+                _repetitions.clear();
+
+                restoreState();
+            }
+        }
+    }
+
+    // "16" or "0..1024"
+    static bool parseRange(const std::string &text, size_t &from, size_t &to)
+    {
+        char *end;
+        from = to = strtoull(text.c_str(), &end, 10);
+        if (end != text.c_str() && strncmp(end, "..", 2) == 0) {
+            const char *rest = end + 2;
+            to = strtoull(rest, &end, 10);
+            if (end == rest) {
+                return false;
+            }
+        }
+        return end != text.c_str() && *end == 0 && from <= to;
+    }
+
+    // "-10..10,hex,pad=4": a range of integers, and options of IntegerGenerator
+    static bool parseIntegers(const std::string &text, int64_t &from, int64_t &to,
+                              typename IntegerGenerator_::Format &format)
+    {
+        char *end;
+        errno = 0;
+        to = from = strtoll(text.c_str(), &end, 10);
+        if (end == text.c_str()) {
+            return false;
+        }
+        if (strncmp(end, "..", 2) == 0) {
+            const char *rest = end + 2;
+            to = strtoll(rest, &end, 10);
+            if (end == rest) {
+                return false;
+            }
+        }
+        if (errno == ERANGE || from > to) {
+            return false;
+        }
+        std::stringstream options(end);
+        std::string option;
+        if (*end != 0 && *end != ',') {
+            return false;
+        }
+        options.ignore();
+        while (std::getline(options, option, ',')) {
+            if (option == "hex" || option == "HEX") {
+                format.base = 16;
+                format.uppercase = option == "HEX";
+            } else if (option.compare(0, 4, "pad=") == 0) {
+                format.pad = strtoul(option.c_str() + 4, &end, 10);
+                if (*end != 0 || format.pad > 64) {
+                    return false;
+                }
+            } else if (option.compare(0, 5, "base=") == 0) {
+                format.base = strtoul(option.c_str() + 5, &end, 10);
+                if (*end != 0 || format.base < 2 || format.base > 36) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // "-90..90,precision=6": a range of numbers, and how many decimals they have if that's
+    // fixed (-1 otherwise)
+    static bool parseFloats(const std::string &text, double &from, double &to, int &precision)
+    {
+        std::string range = text.substr(0, text.find(','));
+        size_t dots = range.find("..");
+        std::string first = range.substr(0, dots), last = dots == std::string::npos ? first : range.substr(dots + 2);
+        char *end;
+        from = strtod(first.c_str(), &end);
+        if (first.empty() || *end != 0) {
+            return false;
+        }
+        to = strtod(last.c_str(), &end);
+        if (last.empty() || *end != 0 || !std::isfinite(from) || !std::isfinite(to) || from > to) {
+            return false;
+        }
+        precision = -1;
+        if (range.size() == text.size()) {
+            return true;
+        }
+        std::string option = text.substr(range.size() + 1);
+        if (option.compare(0, 10, "precision=") != 0 || option.size() == 10) {
+            return false;
+        }
+        precision = static_cast<int>(strtol(option.c_str() + 10, &end, 10));
+        return *end == 0 && precision >= 0 && precision <= 18;
+    }
+
+    // `value` in units of 10^-decimals, rounded up or down unless it's one up to the
+    // error of parsing it
+    static bool toUnits(double value, int decimals, bool up, int64_t &units)
+    {
+        long double scaled = value * std::pow(10.0L, decimals), nearest = std::round(scaled);
+        if (std::abs(scaled - nearest) > 1e-15L * std::abs(scaled)) {
+            nearest = up ? std::ceil(scaled) : std::floor(scaled);
+        }
+        if (!(std::abs(nearest) < 9.2e18L)) {
+            return false;
+        }
+        units = static_cast<int64_t>(nearest);
+        return true;
+    }
+
+    // "2024-02-29", "2024-02-29T23:59:59" (or with a space instead of the T), possibly with
+    // ".999" milliseconds and a "Z": milliseconds since 1970-01-01T00:00:00Z. The end of a
+    // range stands for the last millisecond of its day if it's only a date.
+    static bool parseTimestamp(const std::string &text, bool end, int64_t &milliseconds)
+    {
+        static const unsigned monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        auto number = [&text](size_t at, size_t digits, unsigned &value) {
+            value = 0;
+            for (size_t i = at; i < at + digits; ++i) {
+                if (i >= text.size() || text[i] < '0' || text[i] > '9') {
+                    return false;
+                }
+                value = value * 10 + (text[i] - '0');
+            }
+            return true;
+        };
+        unsigned year, month, day, hour = 0, minute = 0, second = 0, millisecond = 0;
+        if (!number(0, 4, year) || text.compare(4, 1, "-") != 0 || !number(5, 2, month)
+                || text.compare(7, 1, "-") != 0 || !number(8, 2, day)) {
+            return false;
+        }
+        size_t at = 10;
+        if (at == text.size()) {
+            millisecond = end ? 86400000 - 1 : 0;
+        } else {
+            if ((text[at] != 'T' && text[at] != ' ') || !number(11, 2, hour) || text.compare(13, 1, ":") != 0
+                    || !number(14, 2, minute) || text.compare(16, 1, ":") != 0 || !number(17, 2, second)) {
+                return false;
+            }
+            at = 19;
+            if (text.compare(at, 1, ".") == 0) {
+                if (!number(20, 3, millisecond)) {
+                    return false;
+                }
+                at = 23;
+            }
+            at += text.compare(at, std::string::npos, "Z") == 0;
+        }
+        bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+        if (at != text.size() || month < 1 || month > 12 || day < 1 || day > monthDays[month - 1] + (month == 2 && leap)
+                || hour > 23 || minute > 59 || second > 59) {
+            return false;
+        }
+        milliseconds = (((daysFromCivil(year, month, day) * 24 + hour) * 60 + minute) * 60 + second) * 1000 + millisecond;
+        return true;
+    }
+
+    // "2024-01-01..2024-12-31,iso-ms,monotonic=5m": a range of timestamps in units of the
+    // format (ISO ones by default), and the mean step of monotonic ones (0 if they aren't)
+    static bool parseDates(const std::string &text, int64_t &from, int64_t &to,
+                           typename DateGenerator_::Format &format, double &meanStep)
+    {
+        static const struct { const char *name; typename DateGenerator_::Format format; } formats[] = {
+            {"date", DateGenerator_::DATE}, {"iso", DateGenerator_::ISO}, {"iso-ms", DateGenerator_::ISO_MILLIS},
+            {"epoch", DateGenerator_::EPOCH}, {"epoch-ms", DateGenerator_::EPOCH_MILLIS}};
+        static const struct { char suffix; double milliseconds; } steps[] = {
+            {'s', 1000}, {'m', 60000}, {'h', 3600000}, {'d', 86400000}};
+
+        std::stringstream options(text);
+        std::string range, option;
+        std::getline(options, range, ',');
+        size_t dots = range.find("..");
+        int64_t first, last;
+        if (!parseTimestamp(range.substr(0, dots), false, first)
+                || !parseTimestamp(dots == std::string::npos ? range : range.substr(dots + 2), true, last)) {
+            return false;
+        }
+        format = DateGenerator_::ISO;
+        double stepMilliseconds = 0;
+        while (std::getline(options, option, ',')) {
+            bool known = false;
+            for (auto &named : formats) {
+                if (option == named.name) {
+                    format = named.format;
+                    known = true;
+                }
+            }
+            if (option == "monotonic") {
+                stepMilliseconds = -1;
+            } else if (option.compare(0, 10, "monotonic=") == 0) {
+                // "250ms", "5m", "2.5" seconds...
+                char *end;
+                stepMilliseconds = strtod(option.c_str() + 10, &end);
+                double unit = *end == 0 ? 1000 : strcmp(end, "ms") == 0 ? 1 : 0;
+                for (auto &step : steps) {
+                    if (end[0] == step.suffix && end[1] == 0) {
+                        unit = step.milliseconds;
+                    }
+                }
+                stepMilliseconds *= unit;
+                if (end == option.c_str() + 10 || !(stepMilliseconds > 0) || std::isinf(stepMilliseconds)) {
+                    return false;
+                }
+            } else if (!known) {
+                return false;
+            }
+        }
+        // whole units within the range
+        int64_t unit = DateGenerator_::unitOf(format);
+        from = first >= 0 ? (first + unit - 1) / unit : -(-first / unit);
+        to = last >= 0 ? last / unit : -((-last + unit - 1) / unit);
+        meanStep = stepMilliseconds < 0 ? 1 : stepMilliseconds / unit;
+        return from <= to;
+    }
+
+    // {~zipf:1.2}: the previous generator's choice (or count) follows a Distribution
+    void applyDistribution(const std::string &text)
+    {
+        Distribution distribution;
+        if (!Distribution::parse(text, distribution)) {
+            _parseErrors.push_back("Invalid distribution " + text);
+        } else if (_generators.back().empty() || !_generators.back().back()->setDistribution(distribution)) {
+            _parseErrors.push_back("Distribution " + text + " doesn't follow an alternative, a character class, repetitions or a number");
+        }
+    }
+
+    // {name:arguments}, a generator of its own rather than repetitions of the previous one
+    void pushDirective(const std::string &directive)
+    {
+        if (directive[0] == '~') {
+            applyDistribution(directive.substr(1));
+            return;
+        }
+        size_t colon = directive.find(':');
+        std::string name = directive.substr(0, colon);
+        std::string arguments = colon == std::string::npos ? "" : directive.substr(colon + 1);
+        size_t from, to;
+        if (name == "bytes") {
+            if (!parseRange(arguments, from, to)) {
+                _parseErrors.push_back("Invalid length of {bytes:" + arguments + "}");
+                return;
+            }
+            _generators.back().push_back(profiled(std::shared_ptr<Generator>
+                    (std::make_shared<RandomBytesGenerator_>(from, to))));
+        } else if (name == "int") {
+            int64_t first, last;
+            typename IntegerGenerator_::Format format;
+            if (!parseIntegers(arguments, first, last, format)) {
+                _parseErrors.push_back("Invalid {int:" + arguments + "}");
+                return;
+            }
+            _generators.back().push_back(profiled(std::shared_ptr<Generator>
+                    (std::make_shared<IntegerGenerator_>(first, last, format))));
+        } else if (name == "date") {
+            int64_t first, last;
+            typename DateGenerator_::Format format;
+            double meanStep;
+            if (!parseDates(arguments, first, last, format, meanStep)) {
+                _parseErrors.push_back("Invalid {date:" + arguments + "}");
+                return;
+            }
+            std::shared_ptr<Generator> generator;
+            if ((format == DateGenerator_::EPOCH || format == DateGenerator_::EPOCH_MILLIS) && meanStep == 0) {
+                // just numbers, distributed like the other formats
+                typename IntegerGenerator_::Format numbers;
+                numbers.skewOffsets = true;
+                generator = std::make_shared<IntegerGenerator_>(first, last, numbers);
+            } else {
+                generator = std::make_shared<DateGenerator_>(first, last, format, meanStep);
+            }
+            _generators.back().push_back(profiled(std::move(generator)));
+        } else if (name == "float") {
+            double first, last;
+            int precision;
+            int64_t firstUnits, lastUnits;
+            if (!parseFloats(arguments, first, last, precision)) {
+                _parseErrors.push_back("Invalid {float:" + arguments + "}");
+                return;
+            }
+            if (precision < 0) {
+                _generators.back().push_back(profiled(std::shared_ptr<Generator>
+                        (std::make_shared<FloatGenerator_>(first, last))));
+                return;
+            }
+            // fixed decimals are integers of their units
+            if (!toUnits(first, precision, true, firstUnits) || !toUnits(last, precision, false, lastUnits)
+                    || firstUnits > lastUnits) {
+                _parseErrors.push_back("No numbers of " + std::to_string(precision) + " decimals in {float:"
+                                       + arguments + "}");
+                return;
+            }
+            typename IntegerGenerator_::Format format;
+            format.decimals = precision;
+            _generators.back().push_back(profiled(std::shared_ptr<Generator>
+                    (std::make_shared<IntegerGenerator_>(firstUnits, lastUnits, format))));
+        } else {
+            _parseErrors.push_back("Unknown directive " + name);
+        }
+    }
+
+    void processCharInDirectiveState(int character)
+    {
+        if (character == EOL) {
+            _parseErrors.push_back("Unfinished directive");
+            _stream.str("");
+            restoreState();
+        } else if (character == '}') {
+            pushDirective(_stream.str());
+            _stream.str("");
+            restoreState();
+        } else {
+            _stream << static_cast<char>(character);
+        }
+    }
+
+    void addCharToCharAlternative(uint32_t c)
+    {
+        if (_wasDashInCharAlternative) {
+            _wasDashInCharAlternative = false;
+            // TODO: maybe it'd be better to throw an error than silently ignore reversed ranges
+            if (static_cast<uint32_t>(_lastClassChar) < c) {
+                _charClass.add(_lastClassChar + 1, c);
+            }
+            _lastClassChar = -1;
+        } else {
+            _charClass.add(c, c);
+            _lastClassChar = c;
+        }
+    }
+
+    // Whether `c` may follow _utf8Bytes: the byte after E0, ED, F0 and F4 is restricted so
+    // that there are no overlong encodings, surrogates nor code points over U+10FFFF.
+    bool continuesUtf8(uint32_t c) const
+    {
+        if ((c & 0xc0) != 0x80) {
+            return false;
+        }
+        switch (_utf8Bytes.size() == 1 ? static_cast<unsigned char>(_utf8Bytes[0]) : 0) {
+            case 0xe0:
+                return c >= 0xa0;
+            case 0xed:
+                return c < 0xa0;
+            case 0xf0:
+                return c >= 0x90;
+            case 0xf4:
+                return c < 0x90;
+            default:
+                return true;
+        }
+    }
 
-                auto prevGenerator = std::move(_generators.back().back());
-                _generators.back().pop_back();
-                _generators.back().push_back(std::unique_ptr<RepetitionsGenerator_>
-                        (new RepetitionsGenerator_(_repetitions[0], _repetitions[1],
-                                                   std::move(prevGenerator))));
+    // The bytes of an unfinished UTF-8 character are taken as bytes.
+    void flushUtf8Bytes()
+    {
+        _utf8Remaining = 0;
+        for (unsigned char byte : _utf8Bytes) {
+            addCharToCharAlternative(byte);
+        }
+        _utf8Bytes.clear();
+    }
 
-                restoreState();
+    // Characters of a class are decoded from UTF-8; invalid sequences are taken as bytes.
+    void addByteToCharAlternative(int character)
+    {
+        uint32_t c = static_cast<unsigned char>(character);
+        if (_utf8Remaining > 0 && continuesUtf8(c)) {
+            _utf8Bytes += static_cast<char>(c);
+            _utf8CodePoint = (_utf8CodePoint << 6) | (c & 0x3f);
+            if (--_utf8Remaining == 0) {
+                _utf8Bytes.clear();
+                _charClass.setUnicode();
+                addCharToCharAlternative(_utf8CodePoint);
             }
+            return;
+        }
+        flushUtf8Bytes();
+        if (c >= 0xc2 && c <= 0xf4) {
+            _utf8Remaining = c < 0xe0 ? 1 : c < 0xf0 ? 2 : 3;
+            _utf8CodePoint = c & (0x3f >> _utf8Remaining);
+            _utf8Bytes += static_cast<char>(c);
+        } else {
+            addCharToCharAlternative(c);
         }
     }
 
+    // [abc], [a-z], [^0-9]
     void processCharInCharAlternativeState(int character)
     {
+        if (_atCharAlternativeStart) {
+            _atCharAlternativeStart = false;
+            if (character == '^') {
+                _negatedCharAlternative = true;
+                return;
+            }
+        }
+
+        // a UTF-8 character never goes on with anything ASCII, EOL included
+        if (character < 0x80) {
+            flushUtf8Bytes();
+        }
         switch (character) {
             case '\\':
                 setState(BACKSLASH);
                 break;
             case '-':
-                _wasDashInCharAlternative = true;
+                if (_lastClassChar < 0) {
+                    addCharToCharAlternative(character);
+                } else {
+                    _wasDashInCharAlternative = true;
+                }
                 break;
             case ']':
                 restoreState();
             case EOL:
-                pushGenerator<CharAlternativeGenerator_>(_stream);
-                break;
-            default:
                 if (_wasDashInCharAlternative) {
                     _wasDashInCharAlternative = false;
-                    char from = _stream.str().back();
-                    if (from >= character) {
-                        // TODO: maybe it'd be better to throw an error than silently ignore
-                        break;
-                    }
-                    for (char ch = from + 1; ch <= character; ch++) {
-                        _stream << static_cast<char>(ch);
-                    }
-                } else {
-                    _stream << static_cast<char>(character);    
+                    addCharToCharAlternative('-');
                 }
+                _charClass.normalize();
+                if (_negatedCharAlternative) {
+                    _charClass = _charClass.negated();
+                }
+                if (!_charClass.empty()) {
+                    _generators.back().push_back(profiled(std::shared_ptr<Generator>
+                            (std::make_shared<CharAlternativeGenerator_>(std::move(_charClass)))));
+                }
+                _charClass = CharClass();
+                break;
+            default:
+                addByteToCharAlternative(character);
+        }
+    }
+
+    void pushCharClass(CharClass &&chars)
+    {
+        if (_state == CHAR_ALTERNATIVE) {
+            _charClass.add(chars);
+            _lastClassChar = -1;
+        } else if (!chars.empty()) {
+            pushGenerator<ConstGenerator>(_stream);
+            _generators.back().push_back(profiled(std::shared_ptr<Generator>
+                    (std::make_shared<CharAlternativeGenerator_>(std::move(chars)))));
+        }
+    }
+
+    bool processCharInEscapeSequenceStateAndTellIfShouldRerun(int character)
+    {
+        if (character == EOL) {
+            _parseErrors.push_back("Unfinished escape sequence");
+            restoreState();
+            return true;
+        }
+        _escape += static_cast<char>(character);
+        bool braced = _escape[0] == '{';
+        size_t digits = _escapeKind == 'u' ? 4 : _escapeKind == 'x' ? 2 : 1;
+        if (braced ? character != '}' : _escape.size() < digits) {
+            return false;
+        }
+
+        std::string body = braced ? _escape.substr(1, _escape.size() - 2) : _escape;
+        restoreState();
+        if (_escapeKind == 'p') {
+            CharClass chars = CharClass::unicodeCategory(body);
+            if (chars.empty()) {
+                _parseErrors.push_back("Unknown Unicode category " + body);
+            }
+            pushCharClass(std::move(chars));
+        } else if (_escapeKind == 'x') {
+            // a byte, except in a Unicode class, where it's the code point of the same value
+            // (so \xff in [\xff\p{Lu}] is U+00FF, generated as c3 bf)
+            uint32_t byte;
+            if (!parseHex(body, byte) || byte > 0xff) {
+                _parseErrors.push_back("Invalid byte " + body);
+            } else if (_state == CHAR_ALTERNATIVE) {
+                addCharToCharAlternative(byte);
+            } else {
+                _stream << static_cast<char>(byte);
+            }
+        } else {
+            uint32_t codePoint;
+            if (!parseHex(body, codePoint) || codePoint > 0x10ffff || (codePoint >= 0xd800 && codePoint <= 0xdfff)) {
+                _parseErrors.push_back("Invalid code point " + body);
+            } else if (_state == CHAR_ALTERNATIVE) {
+                _charClass.setUnicode();
+                addCharToCharAlternative(codePoint);
+            } else {
+                std::string utf8;
+                appendUtf8(utf8, codePoint);
+                _stream << utf8;
+            }
+        }
+        return false;
+    }
+
+    void pushVariable(MapOfGenerators *mapOfGenerators)
+    {
+        if (_stream.str().size() > 0) {
+            auto variable = std::make_shared<VariableGenerator>(_stream.str());
+            if (mapOfGenerators != nullptr) {
+                variable->link(*mapOfGenerators);
+            }
+            if (_variables != nullptr) {
+                _variables->push_back(variable.get());
+            }
+            _generators.back().push_back(profiled(std::shared_ptr<Generator>(std::move(variable))));
+            _stream.str("");
         }
     }
 
-    bool processCharInVariableNameStateAndTellIfShouldReturn(int character, const MapOfGenerators &mapOfGenerators)
+    bool processCharInVariableNameStateAndTellIfShouldReturn(int character, MapOfGenerators *mapOfGenerators)
     {
         if (isAlpha(character)) {
             _stream << static_cast<char>(character);
         } else {
-            pushGenerator<VariableGenerator>(_stream, std::cref(mapOfGenerators));
+            pushVariable(mapOfGenerators);
             restoreState();
             return true;
         }
         return false;
     }
 
-    bool processCharAndTellIfShouldRerun(int character, const MapOfGenerators &mapOfGenerators, bool varsNotAllowed)
+    bool processCharAndTellIfShouldRerun(int character, MapOfGenerators *mapOfGenerators, bool varsNotAllowed)
     {
         switch (_state) {
             case DEFAULT:
@@ -480,46 +6364,190 @@ private:
                 processCharInCharAlternativeState(character);
                 break;
             case BACKSLASH:
-                _stream << static_cast<char>(character);
+                if (character == 'u' || character == 'p' || character == 'x') {
+                    _state = ESCAPE_SEQUENCE;
+                    _escapeKind = character;
+                    _escape.clear();
+                    break;
+                }
                 restoreState();
+                if (_state == CHAR_ALTERNATIVE) {
+                    addCharToCharAlternative(static_cast<unsigned char>(character));
+                } else {
+                    _stream << static_cast<char>(character);
+                }
                 break;
+            case ESCAPE_SEQUENCE:
+                return processCharInEscapeSequenceStateAndTellIfShouldRerun(character);
+            case DIRECTIVE:
+                processCharInDirectiveState(character);
+                return character == EOL;
         }
 
         return false;
     }
 
-    std::unique_ptr<Generator> parseRegex(const std::string &regex, const MapOfGenerators &mapOfGenerators, bool varsNotAllowed = false)
+    std::unique_ptr<Generator> parseRegex(const std::string &regex, MapOfGenerators *mapOfGenerators, bool varsNotAllowed = false)
     {
         std::function<void(int)> processChar = [&, this](int character)
         {
             while (processCharAndTellIfShouldRerun(character, mapOfGenerators, varsNotAllowed));
         };
 
-        std::for_each(regex.begin(), regex.end(), processChar);
+        // as unsigned chars, so that no byte (0xff in particular) can be taken for EOL
+        for (unsigned char character : regex) {
+            processChar(character);
+        }
         processChar(EOL);
 
         if (_state != DEFAULT) {
             _parseErrors.push_back("Finished parsing in an unexpected state");
         }
 
-        return std::move(_generators.back().back());
+        if (!_result) {
+            // EOL hasn't been reached in the default state, just return what's been parsed
+            auto seriesGen = std::unique_ptr<SeriesOfGeneratorsGenerator>(new SeriesOfGeneratorsGenerator());
+            seriesGen->swapContents(_generators.back());
+            _result = std::move(seriesGen);
+        }
+
+        return std::move(_result);
+    }
+};
+
+// Generates rows of a FixedShape BLOCK_ROWS at a time, in a structure-of-arrays layout:
+// every pick is drawn for all the rows of a block at once, in a loop the compiler can
+// vectorize, and then the columns are transposed into the rows.
+template<typename RandNumGenerator = PlainRandomNumberGenerator>
+class RowBlockGenerator
+{
+public:
+    enum { BLOCK_ROWS = 32 };
+
+private:
+    FixedShape _shape;
+    RandNumGenerator _randNumGenerator;
+    uint32_t _words[BLOCK_ROWS];
+    std::vector<char> _columns; // BLOCK_ROWS chars per pick
+
+public:
+    explicit RowBlockGenerator(FixedShape &&shape)
+        : _shape(std::move(shape)), _columns(_shape.picks.size() * BLOCK_ROWS) {}
+
+    const FixedShape &shape() const
+    {
+        return _shape;
+    }
+
+    // Uniform from [0, count), given the threshold below which low halves of products are
+    // rejected (see generateRows()).
+    uint64_t pickBelow(uint64_t count, uint64_t threshold)
+    {
+        uint64_t product;
+        do {
+            product = (static_cast<uint32_t>(_randNumGenerator.get()) & 0x7fffffffU) * count;
+        } while ((product & 0x7fffffffU) < threshold);
+        return product >> 31;
+    }
+
+    // Appends `rows` rows to `output`, each followed by `separator`.
+    void generateRows(size_t rows, std::string &output, char separator = '\n')
+    {
+        const size_t length = _shape.row.size(), rowSize = length + 1;
+        while (rows > 0) {
+            size_t block = std::min<size_t>(rows, BLOCK_ROWS);
+
+            for (size_t pick = 0; pick < _shape.picks.size(); ++pick) {
+                const std::string &chars = _shape.picks[pick].chars;
+                const uint64_t count = chars.size();
+                char *column = &_columns[pick * BLOCK_ROWS];
+                randomWords(_randNumGenerator, _words, block);
+                // multiply & shift instead of %; the rare products whose low halves fall below
+                // 2^31 % count would make some chars likelier, so they're drawn again (Lemire)
+                const uint64_t threshold = (UINT64_C(1) << 31) % count;
+                uint32_t rejected = 0;
+                for (size_t row = 0; row < block; ++row) {
+                    uint64_t product = (_words[row] & 0x7fffffffU) * count;
+                    column[row] = chars[product >> 31];
+                    rejected |= static_cast<uint32_t>((product & 0x7fffffffU) < threshold) << row;
+                }
+                for (size_t row = 0; rejected != 0; ++row, rejected >>= 1) {
+                    if (rejected & 1) {
+                        column[row] = chars[pickBelow(count, threshold)];
+                    }
+                }
+            }
+
+            size_t start = output.size();
+            output.resize(start + block * rowSize);
+            char *rowsStart = &output[start];
+            for (size_t row = 0; row < block; ++row) {
+                memcpy(rowsStart + row * rowSize, _shape.row.data(), length);
+                rowsStart[row * rowSize + length] = separator;
+            }
+            for (size_t pick = 0; pick < _shape.picks.size(); ++pick) {
+                const char *column = &_columns[pick * BLOCK_ROWS];
+                char *out = rowsStart + _shape.picks[pick].position;
+                for (size_t row = 0; row < block; ++row) {
+                    out[row * rowSize] = column[row];
+                }
+            }
+            rows -= block;
+        }
+    }
+};
+
+// Per-row limits for ConfigFile::generate(). Rows which could exceed them (judging by
+// their static worst case) are generated by the iterative engine, which checks the
+// limits on every step; `policy` says what to do with rows which do exceed them.
+struct GenerationBudget
+{
+    enum Policy {
+        FAIL,       // generate() returns false, leaving the output as it was
+        TRUNCATE,   // the row is cut to maxBytes
+        RESAMPLE,   // the row is generated anew, up to maxResamples times, then it fails
+    };
+
+    size_t maxBytes = static_cast<size_t>(-1);
+    size_t maxNodeVisits = static_cast<size_t>(-1);
+    Policy policy = FAIL;
+    int maxResamples = 100;
+
+    bool unlimited() const
+    {
+        return maxBytes == static_cast<size_t>(-1) && maxNodeVisits == static_cast<size_t>(-1);
+    }
+
+    bool allows(const WorstCase &worstCase) const
+    {
+        return worstCase.bytes <= maxBytes && worstCase.nodeVisits <= maxNodeVisits;
     }
 };
 
 template<typename FileReader = PlainFileReader,
-         typename RandNumGenerator = PlainRandomNumberGenerator>
+         typename RandNumGenerator = PlainRandomNumberGenerator,
+         typename Profiler = NullProfiler>
 class ConfigFile
 {
 public:
-    ConfigFile(std::string fileName)
+    // With parseThreads > 1 (0 meaning one per core) the regexes are parsed concurrently,
+    // see parseInParallel(). Profiling builds always parse sequentially.
+    // Parsing stops at the first line with an error, see getParseError().
+    ConfigFile(std::string fileName, unsigned parseThreads = 1)
     {
         FileReader file(fileName);
-        parse(file);
+        parse(file, parseThreads);
+    }
+
+    ConfigFile(FileReader &file, unsigned parseThreads = 1)
+    {
+        parse(file, parseThreads);
     }
 
-    ConfigFile(FileReader &file)
+    // "Line n: " and what's wrong with it, empty if the whole file has been parsed.
+    const std::string &getParseError() const
     {
-        parse(file);
+        return _parseError;
     }
 
     const std::vector<std::pair<std::string, std::string>> & getLines()
@@ -532,14 +6560,261 @@ public:
         return _generatorsMap;
     }
 
+    Profiler &getProfiler()
+    {
+        return _profiler;
+    }
+
+    // Optimizes all the generators bottom-up, without recursion, then shares their subtrees.
+    void optimize()
+    {
+        std::unordered_set<Generator *> visited;
+        for (auto &entry : _generatorsMap) {
+            visitGenerators(entry.second.get(), visited, [](Generator *generator) { generator->optimize(); });
+        }
+        shareSubtrees();
+        _depths.clear();
+        _worstCases.clear();
+        _rowBlocks.clear();
+    }
+
+    // Generators nested deeper than this (variables included) are run by the IterativeEngine,
+    // shallower ones recursively.
+    void setIterativeEngineDepth(size_t depth)
+    {
+        _iterativeEngineDepth = depth;
+    }
+
+    void setBudget(const GenerationBudget &budget)
+    {
+        _budget = budget;
+    }
+
+    const GenerationBudget &getBudget() const
+    {
+        return _budget;
+    }
+
+    // Longest string the named generator can generate and most generators visited on the
+    // way, both unbounded (static_cast<size_t>(-1)) for recursive generators.
+    WorstCase worstCase(const std::string &name)
+    {
+        return worstCase(_generatorsMap.lookup(name));
+    }
+
+    WorstCase worstCase(MapOfGenerators::SymbolId id)
+    {
+        if (_worstCases.size() <= id) {
+            _worstCases.resize(_generatorsMap.symbolCount(), std::make_pair(false, WorstCase{0, 0}));
+        }
+        if (!_worstCases[id].first) {
+            Generator *generator = _generatorsMap.get(id);
+            _worstCases[id] = std::make_pair(true, generator ? Randodo::worstCase(generator) : WorstCase{0, 0});
+        }
+        return _worstCases[id].second;
+    }
+
+    // Appends a string generated by the named generator to context.output(). Returns false
+    // if there's no such generator, if the iterative engine has run out of stack, or if the
+    // budget has been exceeded (see budgetExceeded()) and the policy doesn't allow that.
+    bool generate(const std::string &name, GenerationContext &context)
+    {
+        return generate(_generatorsMap.lookup(name), context);
+    }
+
+    bool generate(MapOfGenerators::SymbolId id, GenerationContext &context)
+    {
+        Generator *generator = id == MapOfGenerators::npos ? nullptr : _generatorsMap.get(id);
+        _budgetExceeded = false;
+        if (generator == nullptr) {
+            return false;
+        }
+        if (!_budget.unlimited() && !_budget.allows(worstCase(id))) {
+            return generateWithinBudget(*generator, context);
+        }
+        if (depthOf(id) > _iterativeEngineDepth) {
+            return _engine.run(*generator, context);
+        }
+        generator->generate(context);
+        return true;
+    }
+
+    // Appends `count` rows generated by the generator to `output`, each followed by
+    // `separator`. Generators of a fixed shape are generated in blocks of rows by a
+    // RowBlockGenerator, others row by row. Returns false where generate() would.
+    bool generateRows(MapOfGenerators::SymbolId id, size_t count, std::string &output, char separator = '\n')
+    {
+        if (RowBlockGenerator<RandNumGenerator> *rowBlocks = rowBlocksOf(id)) {
+            rowBlocks->generateRows(count, output, separator);
+            return true;
+        }
+        GenerationContext context;
+        context.output().swap(output);
+        bool generated = true;
+        for (size_t i = 0; i < count && generated; ++i) {
+            generated = generate(id, context);
+            context.output() += separator;
+        }
+        context.output().swap(output);
+        return generated;
+    }
+
+    // The shape of the generator's strings if it's fixed and within the budget, nullptr otherwise.
+    const FixedShape *fixedShape(MapOfGenerators::SymbolId id)
+    {
+        RowBlockGenerator<RandNumGenerator> *rowBlocks = rowBlocksOf(id);
+        return rowBlocks ? &rowBlocks->shape() : nullptr;
+    }
+
+    // Whether the last generate() has hit the budget.
+    bool budgetExceeded() const
+    {
+        return _budgetExceeded;
+    }
+
+    // True if the named generator refers to itself, directly or through other generators.
+    // Such generators can only be used with the iterative engine or a BoltzmannSampler,
+    // both of which bound the output.
+    bool isRecursive(const std::string &name)
+    {
+        auto id = _generatorsMap.lookup(name);
+        if (id == MapOfGenerators::npos) {
+            return false;
+        }
+        if (_recursive.empty()) {
+            findRecursiveGenerators();
+        }
+        return _recursive[id];
+    }
+
+    // Names of all recursive generators, in the order of their definitions.
+    std::vector<std::string> recursiveGenerators()
+    {
+        std::vector<std::string> names;
+        for (auto &line : _lines) {
+            if (isRecursive(line.first) && std::find(names.begin(), names.end(), line.first) == names.end()) {
+                names.push_back(line.first);
+            }
+        }
+        return names;
+    }
+
+    // Compiles the named generator into `dfa`, which then validates what it generates.
+    // Returns false if there's no such generator, if it's recursive or if the automaton
+    // would be too big.
+    bool compileDfa(const std::string &name, Dfa &dfa)
+    {
+        return compileDfa(_generatorsMap.lookup(name), dfa);
+    }
+
+    bool compileDfa(MapOfGenerators::SymbolId id, Dfa &dfa)
+    {
+        Generator *generator = id == MapOfGenerators::npos ? nullptr : _generatorsMap.get(id);
+        return generator != nullptr && dfa.compile(*generator);
+    }
+
+    // Merges structurally identical subtrees of all the generators, returns how many
+    // generators have been replaced by an identical one.
+    size_t shareSubtrees()
+    {
+        SubtreeSharing sharing;
+        for (auto &entry : _generatorsMap) {
+            sharing.shareChildren(*entry.second);
+        }
+        return sharing.merged();
+    }
+
 private:
 
     std::vector<std::pair<std::string, std::string>> _lines;
+    std::string _parseError;
 
     MapOfGenerators _generatorsMap;
 
-    bool parse(FileReader &file)
+    Profiler _profiler;
+
+    IterativeEngine _engine;
+    size_t _iterativeEngineDepth = 1000;
+    std::vector<size_t> _depths; // by SymbolId, 0 if not computed yet
+
+    GenerationBudget _budget;
+    bool _budgetExceeded = false;
+    std::vector<std::pair<bool, WorstCase>> _worstCases; // by SymbolId, false if not computed yet
+
+    // by SymbolId, nullptr if the shape isn't fixed (or not computed yet, if false)
+    std::vector<std::pair<bool, std::unique_ptr<RowBlockGenerator<RandNumGenerator>>>> _rowBlocks;
+
+    RowBlockGenerator<RandNumGenerator> *rowBlocksOf(MapOfGenerators::SymbolId id)
+    {
+        Generator *generator = id == MapOfGenerators::npos ? nullptr : _generatorsMap.get(id);
+        if (generator == nullptr || (!_budget.unlimited() && !_budget.allows(worstCase(id)))) {
+            return nullptr;
+        }
+        if (_rowBlocks.size() <= id) {
+            _rowBlocks.resize(_generatorsMap.symbolCount());
+        }
+        if (!_rowBlocks[id].first) {
+            FixedShape shape;
+            if (generator->appendFixedShape(shape, 0)) {
+                _rowBlocks[id].second.reset(new RowBlockGenerator<RandNumGenerator>(std::move(shape)));
+            }
+            _rowBlocks[id].first = true;
+        }
+        return _rowBlocks[id].second.get();
+    }
+
+    std::vector<std::vector<MapOfGenerators::SymbolId>> _references; // variables used, by SymbolId
+    std::vector<bool> _recursive; // by SymbolId, empty if not computed yet
+
+    bool generateWithinBudget(Generator &generator, GenerationContext &context)
+    {
+        size_t start = context.output().size();
+        size_t maxOutputSize = context.maxOutputSize(), maxNodeVisits = context.maxNodeVisits();
+        context.setMaxOutputSize(std::min(maxOutputSize, saturatingAdd(start, _budget.maxBytes)));
+        context.setMaxNodeVisits(std::min(maxNodeVisits, _budget.maxNodeVisits));
+
+        int attempts = _budget.policy == GenerationBudget::RESAMPLE ? 1 + _budget.maxResamples : 1;
+        bool generated = false;
+        for (int attempt = 0; attempt < attempts && !generated; ++attempt) {
+            context.output().resize(start);
+            generated = _engine.run(generator, context);
+            _budgetExceeded = _engine.budgetExceeded();
+            if (!_budgetExceeded) {
+                break;
+            }
+        }
+
+        if (!generated && _budgetExceeded && _budget.policy == GenerationBudget::TRUNCATE) {
+            context.output().resize(std::min(context.output().size(), context.maxOutputSize()));
+            generated = true;
+        } else if (!generated) {
+            context.output().resize(start);
+        }
+        context.setMaxOutputSize(maxOutputSize);
+        context.setMaxNodeVisits(maxNodeVisits);
+        return generated;
+    }
+
+    size_t depthOf(MapOfGenerators::SymbolId id)
+    {
+        if (_depths.size() <= id) {
+            _depths.resize(_generatorsMap.symbolCount(), 0);
+        }
+        if (_depths[id] == 0) {
+            _depths[id] = generatorDepth(_generatorsMap.get(id));
+        }
+        return _depths[id];
+    }
+
+    bool parse(FileReader &file, unsigned parseThreads)
     {
+        if (parseThreads == 0) {
+            parseThreads = std::max(1U, std::thread::hardware_concurrency());
+        }
+        if (parseThreads > 1 && !Profiler::enabled) {
+            return parseInParallel(file, parseThreads);
+        }
+
         int lineNum = 0;
 
         std::string line;
@@ -547,13 +6822,175 @@ private:
             lineNum++;
             std::string errMsg;
             if (! parseLine(line, errMsg)) {
+                _parseError = "Line " + std::to_string(lineNum) + ": " + errMsg;
                 return false;
             }
         }
         return true;
     }
-    
+
+    struct ParsedLine
+    {
+        std::string line, name, value, errMsg;
+        bool ok = true;
+        std::unique_ptr<Generator> generator;
+        std::vector<VariableGenerator *> unlinkedVariables;
+    };
+
+    // Lines are independent apart from the variables, so chunks of them are split & parsed
+    // on `threads` threads into unlinked generators, which are then registered and linked
+    // in the file's order, exactly like parse() would do it.
+    bool parseInParallel(FileReader &file, unsigned threads)
+    {
+        std::vector<ParsedLine> lines;
+        std::string line;
+        while (file.readLine(line)) {
+            lines.push_back(ParsedLine());
+            lines.back().line.swap(line);
+        }
+
+        const size_t chunkSize = 256;
+        std::atomic<size_t> nextChunk(0);
+        auto worker = [&]() {
+            for (size_t begin; (begin = nextChunk.fetch_add(chunkSize)) < lines.size(); ) {
+                size_t end = std::min(begin + chunkSize, lines.size());
+                for (size_t i = begin; i < end; ++i) {
+                    ParsedLine &parsed = lines[i];
+                    parsed.ok = splitLine(parsed.line, parsed.name, parsed.value, parsed.errMsg);
+                    if (parsed.ok && !parsed.name.empty()) {
+                        parsed.generator = RegexParser<FileReader, RandNumGenerator, Profiler>
+                            ::parseUnlinkedExpression(parsed.value, parsed.unlinkedVariables, &parsed.errMsg);
+                        parsed.ok = parsed.errMsg.empty();
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        threads = std::min<size_t>(threads, (lines.size() + chunkSize - 1) / chunkSize);
+        for (unsigned i = 1; i < threads; ++i) {
+            pool.push_back(std::thread(worker));
+        }
+        worker();
+        for (auto &thread : pool) {
+            thread.join();
+        }
+
+        for (size_t i = 0; i < lines.size(); ++i) {
+            ParsedLine &parsed = lines[i];
+            if (!parsed.ok) {
+                _parseError = "Line " + std::to_string(i + 1) + ": " + parsed.errMsg;
+                return false;
+            }
+            if (parsed.name.empty()) {
+                continue;
+            }
+            for (auto variable : parsed.unlinkedVariables) {
+                variable->link(_generatorsMap);
+            }
+            _lines.push_back(std::make_pair(parsed.name, parsed.value));
+            if (_generatorsMap.insert(std::make_pair(parsed.name, std::move(parsed.generator))).second) {
+                addReferences(parsed.name, parsed.unlinkedVariables);
+            }
+        }
+        return true;
+    }
+
     bool parseLine(const std::string &line, std::string &errMsg)
+    {
+        std::string name, value;
+        if (!splitLine(line, name, value, errMsg)) {
+            return false;
+        }
+        if (name.empty()) {
+            // blank line or comment
+            return true;
+        }
+
+        std::vector<VariableGenerator *> variables;
+        auto generator = RegexParser<FileReader, RandNumGenerator, Profiler>::parseExpression(value, _generatorsMap, &_profiler,
+                                                                                              &variables, &errMsg);
+        if (!errMsg.empty()) {
+            return false;
+        }
+        _lines.push_back(std::make_pair(name, value));
+        if (_generatorsMap.insert(std::make_pair(name, Profiling<Profiler>::wrap(std::move(generator), &_profiler, name))).second) {
+            addReferences(name, variables);
+        }
+
+        return true;
+    }
+
+    void addReferences(const std::string &name, const std::vector<VariableGenerator *> &variables)
+    {
+        auto id = _generatorsMap.lookup(name);
+        if (_references.size() <= id) {
+            _references.resize(id + 1);
+        }
+        for (auto variable : variables) {
+            _references[id].push_back(variable->id());
+        }
+        _recursive.clear();
+    }
+
+    // Tarjan's strongly connected components over the references, without recursion:
+    // a generator is recursive if it's in a cycle.
+    void findRecursiveGenerators()
+    {
+        const size_t unvisited = static_cast<size_t>(-1);
+        size_t count = _generatorsMap.symbolCount();
+        _references.resize(count);
+        _recursive.assign(count, false);
+        std::vector<size_t> index(count, unvisited), lowLink(count, 0), components;
+        std::vector<bool> onStack(count, false);
+        std::vector<std::pair<size_t, size_t>> frames; // symbol & next reference to follow
+        size_t nextIndex = 0;
+
+        for (size_t start = 0; start < count; ++start) {
+            if (index[start] != unvisited) {
+                continue;
+            }
+            frames.push_back(std::make_pair(start, 0));
+            index[start] = lowLink[start] = nextIndex++;
+            components.push_back(start);
+            onStack[start] = true;
+
+            while (!frames.empty()) {
+                size_t symbol = frames.back().first;
+                if (frames.back().second < _references[symbol].size()) {
+                    size_t referenced = _references[symbol][frames.back().second++];
+                    if (index[referenced] == unvisited) {
+                        index[referenced] = lowLink[referenced] = nextIndex++;
+                        components.push_back(referenced);
+                        onStack[referenced] = true;
+                        frames.push_back(std::make_pair(referenced, 0));
+                    } else if (onStack[referenced]) {
+                        lowLink[symbol] = std::min(lowLink[symbol], index[referenced]);
+                    }
+                    continue;
+                }
+
+                if (lowLink[symbol] == index[symbol]) {
+                    auto first = std::find(components.begin(), components.end(), symbol);
+                    bool cycle = components.end() - first > 1
+                            || std::find(_references[symbol].begin(), _references[symbol].end(), symbol) != _references[symbol].end();
+                    for (auto it = first; it != components.end(); ++it) {
+                        onStack[*it] = false;
+                        _recursive[*it] = cycle;
+                    }
+                    components.erase(first, components.end());
+                }
+                frames.pop_back();
+                if (!frames.empty()) {
+                    size_t parent = frames.back().first;
+                    lowLink[parent] = std::min(lowLink[parent], lowLink[symbol]);
+                }
+            }
+        }
+    }
+
+    // Splits `name=value`; blank lines and comments give an empty name.
+    bool splitLine(const std::string &line, std::string &name, std::string &value, std::string &errMsg)
     {
         enum State {
             DEFAULT,
@@ -572,7 +7009,7 @@ private:
                 case DEFAULT:
                     switch (*it) {
                         case ' ': break;
-                        case '#': return true; // comment
+                        case '#': name.clear(); return true; // comment
                         default:
                             nameStream << *it;
                             state = READING_NAME;
@@ -616,6 +7053,7 @@ private:
 
         if (state == DEFAULT) {
             // blank line
+            name.clear();
             return true;
         }
 
@@ -624,10 +7062,8 @@ private:
             return false;
         }
 
-        std::string &&name = nameStream.str(), &&value = valueStream.str();
-        _lines.push_back(std::make_pair(name, value));
-        _generatorsMap.insert(std::make_pair(name, RegexParser<FileReader, RandNumGenerator>::parseExpression(value, _generatorsMap)));
-
+        name = nameStream.str();
+        value = valueStream.str();
         return true;
     }
 };
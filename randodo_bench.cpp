@@ -0,0 +1,584 @@
+/* License: GPL v2 */
+/* Contact author: wrochniak@gmail.com */
+
+#include "benchmark/benchmark.h"
+#include "randodo.h"
+#include <ctime>
+
+class StringFileReader
+{
+private:
+    std::vector<std::string> _contents;
+    size_t _pos = 0;
+
+public:
+    StringFileReader(const std::vector<std::string> &contents)
+        : _contents(contents) {}
+
+    bool readLine(std::string &where)
+    {
+        if (_pos == _contents.size())
+            return false;
+        where = _contents[_pos++];
+        return true;
+    }
+};
+
+class CountingRandomNumberGenerator
+{
+private:
+    int _current = 0;
+public:
+    int get()
+    {
+        return _current++ & 0x7fffffff;
+    }
+};
+
+typedef Randodo::PlainRandomNumberGenerator Rng;
+
+static const std::vector<std::string> &sampleSpec()
+{
+    static const std::vector<std::string> spec = {
+        "male=(John|Paul|Martin|Hubert|Bozydar)",
+        "female=(Ann|Sharon|Liza|Janina)",
+        "names=($male|$female)",
+        "verb=(loves|hates|likes|ignores)",
+        "how_much=(| very{1,5} much)",
+        "result=$male $verb $female$how_much. By the way, here are 5 random letters: [a-zA-Z]{5}.",
+    };
+    return spec;
+}
+
+// Builds a spec with `lines` named generators, each referring to one of the previous ones.
+static std::vector<std::string> largeSpec(int lines)
+{
+    std::vector<std::string> spec;
+    spec.push_back("g0=[a-z]{4,8}");
+    for (int i = 1; i < lines; ++i) {
+        std::stringstream line;
+        line << "g" << i << "=(id|key|val)-[0-9]{2,6}:$g" << (i / 2) << "(|[A-Z]{1,3})";
+        spec.push_back(line.str());
+    }
+    return spec;
+}
+
+// Runs `gen` once per iteration, like the command-line tool does for every row.
+static void runRows(benchmark::State &state, Randodo::Generator &gen)
+{
+    Randodo::GenerationContext context;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        context.clear();
+        gen.generate(context);
+        bytes += context.output().size();
+    }
+    state.SetBytesProcessed(bytes);
+    state.counters["rows/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+static void BM_ConstGenerator(benchmark::State &state)
+{
+    Randodo::ConstGenerator gen(std::string(state.range(0), 'x'));
+    runRows(state, gen);
+}
+BENCHMARK(BM_ConstGenerator)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_CharAlternativeGenerator(benchmark::State &state)
+{
+    std::string chars;
+    for (int i = 0; i < state.range(0); ++i) {
+        chars += static_cast<char>('!' + i % 94);
+    }
+    Randodo::CharAlternativeGenerator<Rng> gen(chars);
+    runRows(state, gen);
+}
+BENCHMARK(BM_CharAlternativeGenerator)->Arg(2)->Arg(10)->Arg(62);
+
+static void BM_RepetitionsGenerator(benchmark::State &state)
+{
+    Randodo::RepetitionsGenerator<Rng> gen(state.range(0), state.range(1), std::unique_ptr<Randodo::Generator>
+            (new Randodo::CharAlternativeGenerator<Rng>("0123456789")));
+    runRows(state, gen);
+}
+BENCHMARK(BM_RepetitionsGenerator)->Args({8, 8})->Args({1, 64})->Args({1000, 1000});
+
+// counts from an alias table ({0,100}) or from the distribution's own sampler ({0,100000})
+static void BM_SkewedRepetitions(benchmark::State &state, int to, const std::string &distribution)
+{
+    Randodo::RepetitionsGenerator<Rng> gen(0, to, std::unique_ptr<Randodo::Generator>(new Randodo::ConstGenerator("x")));
+    Randodo::Distribution counts;
+    Randodo::Distribution::parse(distribution, counts);
+    gen.setDistribution(counts);
+    gen.optimize();
+    runRows(state, gen);
+}
+BENCHMARK_CAPTURE(BM_SkewedRepetitions, poisson_table, 100, std::string("poisson:20"));
+BENCHMARK_CAPTURE(BM_SkewedRepetitions, poisson_ptrs, 100000, std::string("poisson:20"));
+BENCHMARK_CAPTURE(BM_SkewedRepetitions, normal, 100000, std::string("normal:20,5"));
+BENCHMARK_CAPTURE(BM_SkewedRepetitions, lognormal, 100000, std::string("lognormal:3,0.5"));
+BENCHMARK_CAPTURE(BM_SkewedRepetitions, geometric, 100000, std::string("geometric:20"));
+
+template<typename RandNumGenerator>
+static void BM_RandomBytesGenerator(benchmark::State &state)
+{
+    Randodo::RandomBytesGenerator<RandNumGenerator> gen(state.range(0), state.range(0));
+    runRows(state, gen);
+}
+BENCHMARK_TEMPLATE(BM_RandomBytesGenerator, Randodo::PlainRandomNumberGenerator)->Arg(16)->Arg(4096);
+BENCHMARK_TEMPLATE(BM_RandomBytesGenerator, Randodo::XoshiroLanesRandomNumberGenerator)->Arg(16)->Arg(4096);
+
+typedef Randodo::IntegerGenerator<Randodo::XoshiroLanesRandomNumberGenerator> FastIntegerGenerator;
+
+static void BM_IntegerGenerator(benchmark::State &state, int64_t to, unsigned base, size_t pad)
+{
+    FastIntegerGenerator::Format format;
+    format.base = base;
+    format.pad = pad;
+    FastIntegerGenerator gen(1, to, format);
+    runRows(state, gen);
+}
+BENCHMARK_CAPTURE(BM_IntegerGenerator, million, 1000000, 10, 0);
+BENCHMARK_CAPTURE(BM_IntegerGenerator, int64, INT64_MAX, 10, 0);
+BENCHMARK_CAPTURE(BM_IntegerGenerator, hex_padded, INT64_MAX, 16, 16);
+
+// formatting alone: appendUnsigned (0) against std::to_string (1) and std::stringstream (2)
+static void BM_FormatInteger(benchmark::State &state)
+{
+    std::vector<uint64_t> values;
+    for (int i = 0; i < 1024; ++i) {
+        values.push_back((static_cast<uint64_t>(rand()) << 31 | rand()) >> (i % 62));
+    }
+    std::string output;
+    std::stringstream stream;
+    size_t i = 0;
+    for (auto _ : state) {
+        output.clear();
+        uint64_t value = values[i++ % values.size()];
+        if (state.range(0) == 0) {
+            Randodo::appendUnsigned(output, value);
+        } else if (state.range(0) == 1) {
+            output += std::to_string(value);
+        } else {
+            stream.str("");
+            stream << value;
+            output += stream.str();
+        }
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.counters["values/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_FormatInteger)->Arg(0)->Arg(1)->Arg(2);
+
+// {float:0..1000} in shortest form, and {float:0..1000,precision=2} as integers of cents
+static void BM_FloatGenerator(benchmark::State &state)
+{
+    Randodo::FloatGenerator<Randodo::XoshiroLanesRandomNumberGenerator> gen(0, 1000);
+    runRows(state, gen);
+}
+BENCHMARK(BM_FloatGenerator);
+
+static void BM_FixedDecimals(benchmark::State &state)
+{
+    FastIntegerGenerator::Format format;
+    format.decimals = 2;
+    FastIntegerGenerator gen(0, 100000, format);
+    runRows(state, gen);
+}
+BENCHMARK(BM_FixedDecimals);
+
+// formatting alone: appendDouble (0) against std::stringstream with 17 digits (1)
+static void BM_FormatDouble(benchmark::State &state)
+{
+    std::vector<double> values;
+    for (int i = 0; i < 1024; ++i) {
+        values.push_back(std::ldexp(static_cast<double>(rand()) / RAND_MAX, i % 64 - 32));
+    }
+    std::string output;
+    std::stringstream stream;
+    stream.precision(17);
+    size_t i = 0;
+    for (auto _ : state) {
+        output.clear();
+        double value = values[i++ % values.size()];
+        if (state.range(0) == 0) {
+            Randodo::appendDouble(output, value);
+        } else {
+            stream.str("");
+            stream << value;
+            output += stream.str();
+        }
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.counters["values/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_FormatDouble)->Arg(0)->Arg(1);
+
+// a year of timestamps: dates (0), ISO (1), ISO with milliseconds (2), and monotonic ISO
+// ones a second apart on average (3)
+static void BM_DateGenerator(benchmark::State &state)
+{
+    typedef Randodo::DateGenerator<Randodo::XoshiroLanesRandomNumberGenerator> Gen;
+    const int64_t from = Randodo::daysFromCivil(2024, 1, 1), to = from + 365;
+    static const Gen::Format formats[] = {Gen::DATE, Gen::ISO, Gen::ISO_MILLIS, Gen::ISO};
+    Gen::Format format = formats[state.range(0)];
+    int64_t units = 86400000 / Gen::unitOf(format);
+    Gen gen(from * units, to * units - 1, format, state.range(0) == 3 ? 1 : 0);
+    runRows(state, gen);
+}
+BENCHMARK(BM_DateGenerator)->Arg(0)->Arg(1)->Arg(2)->Arg(3);
+
+// the same ISO timestamps by gmtime_r() and strftime()
+static void BM_Strftime(benchmark::State &state)
+{
+    Randodo::XoshiroLanesRandomNumberGenerator rng;
+    const time_t from = Randodo::daysFromCivil(2024, 1, 1) * 86400;
+    std::string output;
+    char buffer[32];
+    for (auto _ : state) {
+        output.clear();
+        time_t timestamp = from + static_cast<time_t>(Randodo::randomBelow64(rng, 365 * 86400));
+        struct tm parts;
+        gmtime_r(&timestamp, &parts);
+        output.append(buffer, strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &parts));
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.counters["rows/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Strftime);
+
+static void BM_SeriesOfGeneratorsGenerator(benchmark::State &state)
+{
+    std::vector<std::unique_ptr<Randodo::Generator>> parts;
+    for (int i = 0; i < state.range(0); ++i) {
+        parts.push_back(std::unique_ptr<Randodo::Generator>(new Randodo::ConstGenerator("ab")));
+        parts.push_back(std::unique_ptr<Randodo::Generator>(new Randodo::CharAlternativeGenerator<Rng>("xyz")));
+    }
+    Randodo::SeriesOfGeneratorsGenerator gen;
+    gen.swapContents(parts);
+    runRows(state, gen);
+}
+BENCHMARK(BM_SeriesOfGeneratorsGenerator)->Arg(1)->Arg(8)->Arg(64);
+
+static void BM_AlternativeOfGeneratorsGenerator(benchmark::State &state)
+{
+    std::vector<std::unique_ptr<Randodo::Generator>> parts;
+    for (int i = 0; i < state.range(0); ++i) {
+        parts.push_back(std::unique_ptr<Randodo::Generator>(new Randodo::ConstGenerator(std::to_string(i))));
+    }
+    Randodo::AlternativeOfGeneratorsGenerator<Rng> gen;
+    gen.swapContents(parts);
+    runRows(state, gen);
+}
+BENCHMARK(BM_AlternativeOfGeneratorsGenerator)->Arg(2)->Arg(16)->Arg(256);
+
+// uniform (0), Zipf from an alias table (1) and Zipf by rejection-inversion (2)
+static void BM_SkewedCharAlternative(benchmark::State &state)
+{
+    Randodo::CharAlternativeGenerator<Rng> gen(state.range(0) < 2 ? Randodo::CharClass("abcdefghijklmnopqrstuvwxyz")
+                                                                   : Randodo::CharClass::unicodeCategory("L"));
+    Randodo::Distribution zipf;
+    Randodo::Distribution::parse(state.range(0) == 0 ? "uniform" : "zipf:1.1", zipf);
+    gen.setDistribution(zipf);
+    runRows(state, gen);
+}
+BENCHMARK(BM_SkewedCharAlternative)->Arg(0)->Arg(1)->Arg(2);
+
+static void BM_SkewedLanguageSample(benchmark::State &state, const std::string &distribution)
+{
+    StringFileReader reader(std::vector<std::string>{"id=[A-Z]{3}-[0-9]{9}"});
+    Randodo::ConfigFile<StringFileReader> configFile(reader);
+    Randodo::Dfa dfa;
+    configFile.compileDfa("id", dfa);
+    Randodo::Distribution skew;
+    Randodo::Distribution::parse(distribution, skew);
+    Randodo::SkewedLanguageSample<> sample(skew, dfa.languageSize());
+    std::string row;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        dfa.unrank(sample.next(), row);
+        bytes += row.size();
+    }
+    state.SetBytesProcessed(bytes);
+    state.counters["rows/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK_CAPTURE(BM_SkewedLanguageSample, zipf, std::string("zipf:0.99"));
+BENCHMARK_CAPTURE(BM_SkewedLanguageSample, exp, std::string("exp:0.000001"));
+BENCHMARK_CAPTURE(BM_SkewedLanguageSample, hist, std::string("hist:50,30,15,5"));
+
+static void BM_VariableGenerator(benchmark::State &state)
+{
+    std::vector<std::string> spec = largeSpec(state.range(0));
+    spec.push_back("probe=$g" + std::to_string(state.range(0) - 1));
+    StringFileReader reader(spec);
+    Randodo::ConfigFile<StringFileReader> configFile(reader);
+    runRows(state, *configFile.getMapOfGenerators().find("probe")->second);
+}
+BENCHMARK(BM_VariableGenerator)->Arg(2)->Arg(64)->Arg(4096);
+
+template<typename RandNumGenerator>
+static void BM_RandNumGenerator(benchmark::State &state)
+{
+    RandNumGenerator rng;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rng.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_RandNumGenerator, Randodo::PlainRandomNumberGenerator);
+BENCHMARK_TEMPLATE(BM_RandNumGenerator, CountingRandomNumberGenerator);
+BENCHMARK_TEMPLATE(BM_RandNumGenerator, Randodo::XoshiroLanesRandomNumberGenerator);
+
+static void BM_EntropyPoolingBelow(benchmark::State &state)
+{
+    Randodo::EntropyPoolingRandomNumberGenerator<> rng;
+    size_t n = state.range(0);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rng.below(n));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EntropyPoolingBelow)->Arg(2)->Arg(10)->Arg(62)->Arg(1000000);
+
+template<typename RandNumGenerator>
+static void BM_RandNumGeneratorDigits(benchmark::State &state)
+{
+    Randodo::RepetitionsGenerator<RandNumGenerator> gen(16, 16, std::unique_ptr<Randodo::Generator>
+            (new Randodo::CharAlternativeGenerator<RandNumGenerator>("0123456789")));
+    runRows(state, gen);
+}
+BENCHMARK_TEMPLATE(BM_RandNumGeneratorDigits, Randodo::PlainRandomNumberGenerator);
+BENCHMARK_TEMPLATE(BM_RandNumGeneratorDigits, CountingRandomNumberGenerator);
+BENCHMARK_TEMPLATE(BM_RandNumGeneratorDigits, Randodo::EntropyPoolingRandomNumberGenerator<>);
+BENCHMARK_TEMPLATE(BM_RandNumGeneratorDigits, Randodo::XoshiroLanesRandomNumberGenerator);
+BENCHMARK_TEMPLATE(BM_RandNumGeneratorDigits,
+                   Randodo::EntropyPoolingRandomNumberGenerator<Randodo::XoshiroLanesRandomNumberGenerator>);
+
+static void BM_ParseRegex(benchmark::State &state)
+{
+    const std::string regex = "(id|key|val)-[0-9a-fA-F]{2,6}:(foo|bar|[A-Z]{1,3})(|x{1,5}) tail";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Randodo::RegexParser<>::parseExpression(regex));
+    }
+    state.SetBytesProcessed(state.iterations() * regex.size());
+}
+BENCHMARK(BM_ParseRegex);
+
+static void BM_ConfigFileParse(benchmark::State &state)
+{
+    std::vector<std::string> spec = state.range(0) == 0 ? sampleSpec() : largeSpec(state.range(0));
+    int64_t specBytes = 0;
+    for (auto &line : spec) {
+        specBytes += line.size() + 1;
+    }
+    for (auto _ : state) {
+        StringFileReader reader(spec);
+        Randodo::ConfigFile<StringFileReader> configFile(reader);
+        benchmark::DoNotOptimize(configFile.getMapOfGenerators().size());
+    }
+    state.SetBytesProcessed(state.iterations() * specBytes);
+    state.counters["lines/s"] = benchmark::Counter(state.iterations() * spec.size(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ConfigFileParse)->Arg(0)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_ConfigFileParseParallel(benchmark::State &state)
+{
+    std::vector<std::string> spec = largeSpec(100000);
+    for (auto _ : state) {
+        StringFileReader reader(spec);
+        Randodo::ConfigFile<StringFileReader> configFile(reader, state.range(0));
+        benchmark::DoNotOptimize(configFile.getMapOfGenerators().size());
+    }
+    state.counters["lines/s"] = benchmark::Counter(state.iterations() * spec.size(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ConfigFileParseParallel)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_ConfigFileOptimize(benchmark::State &state)
+{
+    std::vector<std::string> spec = largeSpec(state.range(0));
+    size_t merged = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        StringFileReader reader(spec);
+        Randodo::ConfigFile<StringFileReader> configFile(reader);
+        state.ResumeTiming();
+        configFile.optimize();
+        merged = configFile.shareSubtrees();
+    }
+    state.counters["lines/s"] = benchmark::Counter(state.iterations() * spec.size(), benchmark::Counter::kIsRate);
+    benchmark::DoNotOptimize(merged);
+}
+BENCHMARK(BM_ConfigFileOptimize)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+// Mirrors main.cpp: look the generator up once, then print one row per line.
+static void BM_Pipeline(benchmark::State &state, const std::vector<std::string> &spec, const std::string &name)
+{
+    StringFileReader reader(spec);
+    Randodo::ConfigFile<StringFileReader> configFile(reader);
+    configFile.optimize();
+    auto id = configFile.getMapOfGenerators().lookup(name);
+    Randodo::GenerationContext context;
+    std::string out;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        context.clear();
+        configFile.generate(id, context);
+        out += context.output();
+        out += '\n';
+        bytes += context.output().size() + 1;
+        if (out.size() > (1 << 20)) {
+            out.clear();
+        }
+    }
+    state.SetBytesProcessed(bytes);
+    state.counters["rows/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK_CAPTURE(BM_Pipeline, readme_sample, sampleSpec(), std::string("result"));
+BENCHMARK_CAPTURE(BM_Pipeline, id_column, std::vector<std::string>{"id=[A-Z]{3}-[0-9]{6}"}, std::string("id"));
+BENCHMARK_CAPTURE(BM_Pipeline, padding, std::vector<std::string>{"pad=-{10000}"}, std::string("pad"));
+BENCHMARK_CAPTURE(BM_Pipeline, cyrillic, std::vector<std::string>{"word=[\u0400-\u04ff]{5,12}"}, std::string("word"));
+BENCHMARK_CAPTURE(BM_Pipeline, unicode_letters, std::vector<std::string>{"word=\\p{L}{5,12}"}, std::string("word"));
+
+// The same rows as BM_Pipeline/id_column, but generated in blocks
+// Validates batches of rows generated by the spec against its Dfa.
+static void BM_DfaMatchMany(benchmark::State &state, const std::vector<std::string> &spec, const std::string &name)
+{
+    StringFileReader reader(spec);
+    Randodo::ConfigFile<StringFileReader> configFile(reader);
+    Randodo::Dfa dfa;
+    if (!configFile.compileDfa(name, dfa)) {
+        state.SkipWithError("not compiled");
+        return;
+    }
+    std::vector<std::string> rows(4096);
+    Randodo::GenerationContext context;
+    int64_t bytes = 0;
+    for (auto &row : rows) {
+        context.clear();
+        configFile.generate(name, context);
+        row = context.output();
+        bytes += row.size();
+    }
+    std::unique_ptr<bool[]> matches(new bool[rows.size()]);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(dfa.matchMany(rows.data(), rows.size(), matches.get()));
+    }
+    state.SetBytesProcessed(bytes * state.iterations());
+    state.counters["rows/s"] = benchmark::Counter(rows.size() * state.iterations(), benchmark::Counter::kIsRate);
+    state.counters["states"] = dfa.states();
+}
+BENCHMARK_CAPTURE(BM_DfaMatchMany, readme_sample, sampleSpec(), std::string("result"));
+BENCHMARK_CAPTURE(BM_DfaMatchMany, id_column, std::vector<std::string>{"id=[A-Z]{3}-[0-9]{6}"}, std::string("id"));
+BENCHMARK_CAPTURE(BM_DfaMatchMany, unicode_letters, std::vector<std::string>{"word=\\p{L}{5,12}"}, std::string("word"));
+
+static void BM_DfaEnumerate(benchmark::State &state)
+{
+    // more strings than the benchmark can possibly walk
+    StringFileReader reader(std::vector<std::string>{"id=[A-Z]{3}-[0-9]{9}"});
+    Randodo::ConfigFile<StringFileReader> configFile(reader);
+    Randodo::Dfa dfa;
+    configFile.compileDfa("id", dfa);
+    Randodo::Dfa::Enumerator enumerator(dfa);
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        bytes += enumerator.string().size();
+        enumerator.next();
+    }
+    state.SetBytesProcessed(bytes);
+    state.counters["rows/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_DfaEnumerate);
+
+static void BM_DfaCompile(benchmark::State &state, const std::vector<std::string> &spec, const std::string &name)
+{
+    StringFileReader reader(spec);
+    Randodo::ConfigFile<StringFileReader> configFile(reader);
+    for (auto _ : state) {
+        Randodo::Dfa dfa;
+        benchmark::DoNotOptimize(configFile.compileDfa(name, dfa));
+    }
+}
+BENCHMARK_CAPTURE(BM_DfaCompile, readme_sample, sampleSpec(), std::string("result"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DfaCompile, unicode_letters, std::vector<std::string>{"word=\\p{L}{5,12}"}, std::string("word"))
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ExactLength(benchmark::State &state)
+{
+    StringFileReader reader(std::vector<std::string>{"name=(Ann|Sharon|Liza)", "id=[0-9]{1,6}",
+                                                     "key=$name-$id-[a-z]{1,200}"});
+    Randodo::ConfigFile<StringFileReader> configFile(reader);
+    auto &generators = configFile.getMapOfGenerators();
+    Randodo::ExactLengthSampler<> sampler(*generators.get(generators.lookup("key")), state.range(0), state.range(0));
+    Randodo::GenerationContext context;
+    for (auto _ : state) {
+        context.clear();
+        sampler.generate(context);
+    }
+    state.SetBytesProcessed(state.range(0) * state.iterations());
+    state.counters["rows/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ExactLength)->Arg(16)->Arg(128);
+
+static void BM_SortedSample(benchmark::State &state)
+{
+    StringFileReader reader(std::vector<std::string>{"id=[A-Z]{3}-[0-9]{9}"});
+    Randodo::ConfigFile<StringFileReader> configFile(reader);
+    Randodo::Dfa dfa;
+    configFile.compileDfa("id", dfa);
+    // sparse samples skip ahead by Vitter's Algorithm D, dense ones use selection sampling
+    Randodo::LanguageSize count = state.range(0) ? dfa.languageSize() / state.range(0) : 1000000;
+    std::unique_ptr<Randodo::SortedSample<>> sample(new Randodo::SortedSample<>(0, dfa.languageSize(), count));
+    Randodo::LanguageSize index = 0;
+    std::string row;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        if (!sample->next(index)) {
+            sample.reset(new Randodo::SortedSample<>(0, dfa.languageSize(), count));
+            sample->next(index);
+        }
+        dfa.unrank(index, row);
+        bytes += row.size();
+    }
+    state.SetBytesProcessed(bytes);
+    state.counters["rows/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SortedSample)->Arg(0)->Arg(2);
+
+template<typename RandNumGenerator>
+static void BM_RowBlocks(benchmark::State &state)
+{
+    StringFileReader reader(std::vector<std::string>{"id=[A-Z]{3}-[0-9]{6}"});
+    Randodo::ConfigFile<StringFileReader, RandNumGenerator> configFile(reader);
+    configFile.optimize();
+    auto id = configFile.getMapOfGenerators().lookup("id");
+    std::string out;
+    const int rows = 1024;
+    for (auto _ : state) {
+        out.clear();
+        configFile.generateRows(id, rows, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * out.size());
+    state.counters["rows/s"] = benchmark::Counter(state.iterations() * rows, benchmark::Counter::kIsRate);
+}
+BENCHMARK_TEMPLATE(BM_RowBlocks, Randodo::PlainRandomNumberGenerator);
+BENCHMARK_TEMPLATE(BM_RowBlocks, Randodo::XoshiroLanesRandomNumberGenerator);
+
+// `depth` nested groups: ((((x))))
+static void BM_Engine(benchmark::State &state)
+{
+    std::string regex = std::string(state.range(0), '(') + "[xy]" + std::string(state.range(0), ')') + "{1,3}";
+    StringFileReader reader(std::vector<std::string>{"deep=" + regex});
+    Randodo::ConfigFile<StringFileReader> configFile(reader);
+    configFile.setIterativeEngineDepth(state.range(1) ? 0 : static_cast<size_t>(-1));
+    auto id = configFile.getMapOfGenerators().lookup("deep");
+    Randodo::GenerationContext context;
+    for (auto _ : state) {
+        context.clear();
+        configFile.generate(id, context);
+    }
+    state.counters["rows/s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Engine)->ArgNames({"depth", "iterative"})->ArgsProduct({{1, 100, 1000}, {0, 1}});
+
+BENCHMARK_MAIN();
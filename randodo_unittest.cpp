@@ -3,6 +3,7 @@
 
 #include "gtest/gtest.h"
 #include "randodo.h"
+#include <set>
 
 class FakeFileReader
 {
@@ -168,6 +169,21 @@ TEST(ConfigFile, TestRegexRepetitionsFrom0)
 }
 
 
+TEST(ConfigFile, TestRegexRepetitionsTwice)
+{
+    // the second bounds don't get appended to the first ones
+    std::string regex = "a{2}b{3}";
+    std::unique_ptr<Randodo::Generator> gen = Randodo::RegexParser<FakeFileReader, FakeRandomNumberGenerator>::parseExpression(regex);
+    std::stringstream str1, str2;
+
+    gen->generate(str1);
+    gen->generate(str2);
+
+    ASSERT_EQ("aabbb", str1.str());
+    ASSERT_EQ("aabbb", str2.str());
+}
+
+
 TEST(ConfigFile, TestRegexAlternative)
 {
     std::string regex = "abc(def|[ghi])jkl";
@@ -215,3 +231,1192 @@ TEST(ConfigFile, TestVariable)
     ASSERT_EQ("dwarf g", str1.str());
     ASSERT_EQ("lilliput o", str2.str());
 }
+
+TEST(ConfigFile, TestProfiler)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("gnome=(dwarf|lilliput)");
+    fakeFileReader.addLine("hobbit=$gnome [goblin]");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator, Randodo::CycleCountingProfiler> configFile(fakeFileReader);
+
+    auto iter = configFile.getMapOfGenerators().find("hobbit");
+    ASSERT_NE(configFile.getMapOfGenerators().end(), iter);
+
+    std::stringstream str1, str2;
+    iter->second->generate(str1);
+    iter->second->generate(str2);
+
+    ASSERT_EQ("dwarf g", str1.str());
+    ASSERT_EQ("lilliput o", str2.str());
+
+    std::stringstream tree, folded;
+    configFile.getProfiler().dumpTree(tree);
+    configFile.getProfiler().dumpFoldedStacks(folded);
+
+    // hobbit ran twice and emitted 17 bytes, the path to gnome goes through the variable
+    ASSERT_NE(std::string::npos, tree.str().find("           2          17  hobbit\n"));
+    ASSERT_NE(std::string::npos, folded.str().find("hobbit;alternative;series;$gnome;gnome;alternative;series;alternative;series;\"dwarf\" "));
+}
+
+TEST(ConfigFile, TestMapOfGeneratorsForwardReference)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("hobbit=$gnome-$elf");
+    fakeFileReader.addLine("gnome=dwarf");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader);
+
+    auto &mapOfGenerators = configFile.getMapOfGenerators();
+
+    // "elf" is interned, but as it's undefined it's invisible
+    ASSERT_EQ(2U, mapOfGenerators.size());
+    ASSERT_EQ(3U, mapOfGenerators.symbolCount());
+    ASSERT_EQ(mapOfGenerators.end(), mapOfGenerators.find("elf"));
+    ASSERT_EQ(2, std::distance(mapOfGenerators.begin(), mapOfGenerators.end()));
+
+    std::stringstream str;
+    mapOfGenerators.find("hobbit")->second->generate(str);
+    ASSERT_EQ("dwarf-", str.str());
+}
+
+TEST(ConfigFile, TestMapOfGeneratorsManyNames)
+{
+    Randodo::MapOfGenerators mapOfGenerators;
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(mapOfGenerators.insert(std::make_pair("g" + std::to_string(i),
+                Randodo::RegexParser<>::parseExpression(std::to_string(i)))).second);
+    }
+    ASSERT_FALSE(mapOfGenerators.insert(std::make_pair(std::string("g7"),
+            Randodo::RegexParser<>::parseExpression("x"))).second);
+
+    for (int i = 0; i < 1000; ++i) {
+        Randodo::MapOfGenerators::SymbolId id = mapOfGenerators.lookup("g" + std::to_string(i));
+        ASSERT_EQ(static_cast<size_t>(i), id);
+        std::stringstream str;
+        mapOfGenerators.get(id)->generate(str);
+        ASSERT_EQ(std::to_string(i), str.str());
+    }
+    ASSERT_TRUE(mapOfGenerators.lookup("g1000") == Randodo::MapOfGenerators::npos);
+}
+
+TEST(ConfigFile, TestParallelParse)
+{
+    FakeFileReader sequentialReader, parallelReader;
+    for (int i = 0; i < 2000; ++i) {
+        std::string line = "g" + std::to_string(i) + " = (" + std::to_string(i) + "|[xyz]{1,3})";
+        if (i > 0) {
+            // forward and backward references alike
+            line += "$g" + std::to_string(i % 3 == 0 ? i + 1 : i / 2);
+        }
+        if (i % 100 == 0) {
+            sequentialReader.addLine("# comment");
+            parallelReader.addLine("");
+        }
+        sequentialReader.addLine(line);
+        parallelReader.addLine(line);
+    }
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> sequential(sequentialReader);
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> parallel(parallelReader, 4);
+
+    ASSERT_EQ(sequential.getLines(), parallel.getLines());
+    ASSERT_EQ(2000U, parallel.getMapOfGenerators().size());
+
+    for (int i = 0; i < 2000; i += 37) {
+        std::string name = "g" + std::to_string(i);
+        std::stringstream str1, str2;
+        sequential.getMapOfGenerators().find(name)->second->generate(str1);
+        parallel.getMapOfGenerators().find(name)->second->generate(str2);
+        ASSERT_EQ(str1.str(), str2.str());
+    }
+}
+
+TEST(ConfigFile, TestParseErrors)
+{
+    for (unsigned threads : {1U, 4U}) {
+        FakeFileReader fakeFileReader;
+        fakeFileReader.addLine("ok=abc");
+        fakeFileReader.addLine("bad={int:10..1}X");
+        fakeFileReader.addLine("after=x");
+        Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader, threads);
+        ASSERT_EQ("Line 2: Invalid {int:10..1}", configFile.getParseError());
+        ASSERT_TRUE(configFile.getMapOfGenerators().find("bad") == configFile.getMapOfGenerators().end());
+
+        FakeFileReader distributionReader;
+        distributionReader.addLine("x=a{~zip:1.2}");
+        Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> distribution(distributionReader, threads);
+        ASSERT_EQ("Line 1: Invalid distribution zip:1.2", distribution.getParseError());
+    }
+
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("ok=[abc]{~zipf:1.2}");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader);
+    ASSERT_EQ("", configFile.getParseError());
+
+    std::string errMsg;
+    Randodo::MapOfGenerators generatorsMap;
+    Randodo::RegexParser<FakeFileReader, FakeRandomNumberGenerator>::parseExpression("a{nope}", generatorsMap, nullptr,
+                                                                                      nullptr, &errMsg);
+    ASSERT_EQ("Unknown directive nope", errMsg);
+}
+
+TEST(ConfigFile, TestShareSubtrees)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("a=x[0-9]{2}");
+    fakeFileReader.addLine("b=(y|z)[0-9]{2}");
+    fakeFileReader.addLine("c=(y|z)[0-9]{2}");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader);
+
+    // [0-9] & {2} in b, and everything but the topmost alternative in c
+    ASSERT_EQ(10U, configFile.shareSubtrees());
+    ASSERT_EQ(0U, configFile.shareSubtrees());
+
+    // c's children now share the random number generators of b's
+    auto &mapOfGenerators = configFile.getMapOfGenerators();
+    std::stringstream str1, str2, str3;
+    mapOfGenerators.find("a")->second->generate(str1);
+    mapOfGenerators.find("b")->second->generate(str2);
+    mapOfGenerators.find("c")->second->generate(str3);
+
+    ASSERT_EQ("x01", str1.str());
+    ASSERT_EQ("y23", str2.str());
+    ASSERT_EQ("z45", str3.str());
+}
+
+TEST(ConfigFile, TestIterativeEngine)
+{
+    FakeFileReader recursiveReader, iterativeReader;
+    for (auto reader : {&recursiveReader, &iterativeReader}) {
+        reader->addLine("gnome=(dwarf|lilliput|[xyz]{0,2})");
+        reader->addLine("hobbit=$gnome [goblin]{1,3}(|$gnome)");
+    }
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> recursive(recursiveReader);
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> iterative(iterativeReader);
+    recursive.setIterativeEngineDepth(1000);
+    iterative.setIterativeEngineDepth(0);
+
+    for (int i = 0; i < 20; ++i) {
+        Randodo::GenerationContext context1, context2;
+        ASSERT_TRUE(recursive.generate("hobbit", context1));
+        ASSERT_TRUE(iterative.generate("hobbit", context2));
+        ASSERT_EQ(context1.output(), context2.output());
+    }
+
+    Randodo::GenerationContext context;
+    ASSERT_FALSE(iterative.generate("elf", context));
+}
+
+TEST(ConfigFile, TestIterativeEngineDeepNesting)
+{
+    const int depth = 20000;
+    FakeFileReader fakeFileReader;
+    std::string deep = "x|z";
+    for (int i = 0; i < depth; ++i) {
+        deep = "(" + deep + ")y";
+    }
+    fakeFileReader.addLine("deep=" + deep);
+    fakeFileReader.addLine("deeper=$deep$deep");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader);
+    // optimizing, sharing and (at the end) destroying the generators don't recurse either
+    configFile.optimize();
+
+    // each pair of parentheses gives an alternative and a series, plus the topmost ones
+    // of both lines, the variable and "x"
+    ASSERT_EQ(2U * depth + 6, Randodo::generatorDepth(configFile.getMapOfGenerators().find("deeper")->second.get()));
+
+    Randodo::GenerationContext context;
+    ASSERT_TRUE(configFile.generate("deeper", context));
+    ASSERT_EQ("x" + std::string(depth, 'y') + "z" + std::string(depth, 'y'), context.output());
+
+    // every level leaves "y" to be generated on the stack
+    Randodo::IterativeEngine smallEngine(100);
+    context.clear();
+    ASSERT_FALSE(smallEngine.run(*configFile.getMapOfGenerators().find("deep")->second, context));
+}
+
+TEST(ConfigFile, TestRecursiveGenerators)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("num=[0-9]");
+    fakeFileReader.addLine("expr=($num|\\($term\\+$term\\))");
+    fakeFileReader.addLine("term=($expr|-$term)");
+    fakeFileReader.addLine("self=(x|$self)");
+    fakeFileReader.addLine("user=$expr$num");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader);
+
+    ASSERT_FALSE(configFile.isRecursive("num"));
+    ASSERT_TRUE(configFile.isRecursive("expr"));
+    ASSERT_TRUE(configFile.isRecursive("term"));
+    ASSERT_TRUE(configFile.isRecursive("self"));
+    ASSERT_FALSE(configFile.isRecursive("user"));
+    ASSERT_FALSE(configFile.isRecursive("undefined"));
+    ASSERT_EQ((std::vector<std::string>{"expr", "term", "self"}), configFile.recursiveGenerators());
+}
+
+TEST(ConfigFile, TestBoltzmannSampler)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("num=[0-9]");
+    fakeFileReader.addLine("expr=($num|\\($expr\\+$expr\\))");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> configFile(fakeFileReader);
+    srand(42);
+
+    Randodo::Generator &expr = *configFile.getMapOfGenerators().find("expr")->second;
+    Randodo::BoltzmannSampler sampler(expr, 50, 10, 200);
+    ASSERT_NEAR(50, sampler.expectedSize(), 0.5);
+
+    Randodo::GenerationContext context;
+    for (int i = 0; i < 200; ++i) {
+        context.clear();
+        ASSERT_TRUE(sampler.generate(context));
+        const std::string &row = context.output();
+        ASSERT_GE(row.size(), 10U);
+        ASSERT_LE(row.size(), 200U);
+        int open = 0;
+        for (char c : row) {
+            open += c == '(' ? 1 : c == ')' ? -1 : 0;
+            ASSERT_GE(open, 0);
+        }
+        ASSERT_EQ(0, open);
+    }
+
+    // without recursion there's nothing to tune beyond the longest string
+    Randodo::ConstGenerator constant("abc");
+    Randodo::BoltzmannSampler constantSampler(constant, 50);
+    ASSERT_NEAR(3, constantSampler.expectedSize(), 1e-9);
+
+    // the weights are the sampler's own, so generators sharing subtrees don't follow them
+    FakeFileReader sharedReader;
+    sharedReader.addLine("short=-(x|yyyyyyyy){0,100}");
+    sharedReader.addLine("plain=_(x|yyyyyyyy){0,100}");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> shared(sharedReader);
+    ASSERT_LT(0U, shared.shareSubtrees());
+    Randodo::BoltzmannSampler shortSampler(*shared.getMapOfGenerators().find("short")->second, 3);
+    size_t shortLength = 0, plainLength = 0;
+    for (int i = 0; i < 200; ++i) {
+        context.clear();
+        ASSERT_TRUE(shortSampler.generate(context));
+        shortLength += context.output().size();
+        context.clear();
+        ASSERT_TRUE(shared.generate("plain", context));
+        plainLength += context.output().size();
+    }
+    ASSERT_LT(shortLength / 200, 10U);
+    ASSERT_GT(plainLength / 200, 150U);
+}
+
+TEST(ConfigFile, TestGenerationBudget)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("small=ab[xy]{0,3}");
+    fakeFileReader.addLine("huge=(x{2000,100000}){1,100000}");
+    fakeFileReader.addLine("loop=(x|$loop$loop)");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader);
+
+    Randodo::WorstCase small = configFile.worstCase("small");
+    ASSERT_EQ(5U, small.bytes);
+    // the topmost alternative, the series twice, "ab", the repetitions 3 times and 3 chars
+    ASSERT_EQ(1U + 2 + 1 + 3 + 3, small.nodeVisits);
+    ASSERT_EQ(10000000000U, configFile.worstCase("huge").bytes);
+    ASSERT_EQ(static_cast<size_t>(-1), configFile.worstCase("loop").bytes);
+
+    Randodo::GenerationBudget budget;
+    budget.maxBytes = 1000;
+    configFile.setBudget(budget);
+
+    Randodo::GenerationContext context;
+    context.output() = "row:";
+    ASSERT_TRUE(configFile.generate("small", context));
+    ASSERT_EQ("row:ab", context.output());
+    ASSERT_FALSE(configFile.generate("huge", context));
+    ASSERT_TRUE(configFile.budgetExceeded());
+    ASSERT_EQ("row:ab", context.output());
+
+    budget.policy = Randodo::GenerationBudget::TRUNCATE;
+    configFile.setBudget(budget);
+    ASSERT_TRUE(configFile.generate("huge", context));
+    ASSERT_TRUE(configFile.budgetExceeded());
+    ASSERT_EQ("row:ab" + std::string(1000, 'x'), context.output());
+
+    // the fake random number generator keeps counting, so eventually a row fits
+    budget.policy = Randodo::GenerationBudget::RESAMPLE;
+    budget.maxBytes = static_cast<size_t>(-1);
+    budget.maxNodeVisits = 20;
+    configFile.setBudget(budget);
+    context.clear();
+    ASSERT_TRUE(configFile.generate("loop", context));
+    ASSERT_FALSE(configFile.budgetExceeded());
+    ASSERT_FALSE(context.output().empty());
+}
+
+class CountingSource
+{
+public:
+    static int calls;
+
+    int get()
+    {
+        calls++;
+        return rand();
+    }
+};
+
+int CountingSource::calls = 0;
+
+TEST(ConfigFile, TestEntropyPooling)
+{
+    srand(7);
+    Randodo::EntropyPoolingRandomNumberGenerator<CountingSource> rng;
+    CountingSource::calls = 0;
+    std::vector<int> histogram(10, 0);
+    const int draws = 10000;
+    for (int i = 0; i < draws; ++i) {
+        histogram[rng.below(10)]++;
+    }
+    // log2(10) / 31 calls per digit, plus a little for rejections
+    ASSERT_LT(CountingSource::calls, draws / 8);
+    for (int count : histogram) {
+        ASSERT_NEAR(draws / 10, count, 150);
+    }
+
+    Randodo::RepetitionsGenerator<Randodo::EntropyPoolingRandomNumberGenerator<CountingSource>> digits(16, 16,
+            std::unique_ptr<Randodo::Generator>(new Randodo::CharAlternativeGenerator<
+                Randodo::EntropyPoolingRandomNumberGenerator<CountingSource>>("0123456789")));
+    CountingSource::calls = 0;
+    Randodo::GenerationContext context;
+    digits.generate(context);
+    ASSERT_EQ(16U, context.output().size());
+    ASSERT_LE(CountingSource::calls, 4);
+}
+
+TEST(ConfigFile, TestXoshiroLanes)
+{
+    typedef Randodo::XoshiroLanesRandomNumberGenerator Rng;
+    Rng rng1, rng2;
+    const int count = 3 * Rng::BLOCK_WORDS;
+
+    Rng::seed(12345);
+    std::vector<int> first;
+    for (int i = 0; i < count; ++i) {
+        first.push_back(rng1.get());
+    }
+    // all the instances share the thread's buffer and reseeding restarts it
+    Rng::seed(12345);
+    double mean = 0;
+    for (int i = 0; i < count; ++i) {
+        int value = i % 2 ? rng1.get() : rng2.get();
+        ASSERT_EQ(first[i], value);
+        ASSERT_GE(value, 0);
+        mean += value / 2147483648.0;
+    }
+    ASSERT_NEAR(0.5, mean / count, 0.02);
+
+    Rng::seed(54321);
+    ASSERT_NE(first[0], rng1.get());
+}
+
+TEST(ConfigFile, TestRowBlocks)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("prefix=[A-Z]{3}");
+    fakeFileReader.addLine("id=$prefix-[0-9]{6}");
+    fakeFileReader.addLine("varied=(a|bb)[0-9]");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> configFile(fakeFileReader);
+    configFile.optimize();
+    auto &mapOfGenerators = configFile.getMapOfGenerators();
+
+    const Randodo::FixedShape *shape = configFile.fixedShape(mapOfGenerators.lookup("id"));
+    ASSERT_TRUE(shape != nullptr);
+    ASSERT_EQ(10U, shape->row.size());
+    ASSERT_EQ(9U, shape->picks.size());
+    ASSERT_TRUE(configFile.fixedShape(mapOfGenerators.lookup("varied")) == nullptr);
+
+    // 70 rows: two full blocks and a partial one
+    std::string rows = "header\n";
+    ASSERT_TRUE(configFile.generateRows(mapOfGenerators.lookup("id"), 70, rows));
+    ASSERT_EQ(7U + 70 * 11, rows.size());
+    std::set<std::string> distinct;
+    for (int i = 0; i < 70; ++i) {
+        std::string row = rows.substr(7 + i * 11, 11);
+        for (int j = 0; j < 3; ++j) {
+            ASSERT_TRUE(row[j] >= 'A' && row[j] <= 'Z');
+        }
+        ASSERT_EQ('-', row[3]);
+        for (int j = 4; j < 10; ++j) {
+            ASSERT_TRUE(isdigit(row[j]));
+        }
+        ASSERT_EQ('\n', row[10]);
+        distinct.insert(row);
+    }
+    ASSERT_GT(distinct.size(), 60U);
+
+    // other generators are generated row by row
+    rows.clear();
+    ASSERT_TRUE(configFile.generateRows(mapOfGenerators.lookup("varied"), 3, rows, ';'));
+    ASSERT_EQ(3, std::count(rows.begin(), rows.end(), ';'));
+
+    // 715827883 * 3 is 2^31 + 1, and such words which would make "b" likelier are drawn again
+    struct RejectedFirst
+    {
+        int calls = 0;
+        int get()
+        {
+            return calls++ == 0 ? 715827883 : 1;
+        }
+    };
+    Randodo::FixedShape abc;
+    abc.appendPick("abc");
+    Randodo::RowBlockGenerator<RejectedFirst> unbiased(std::move(abc));
+    rows.clear();
+    unbiased.generateRows(1, rows);
+    ASSERT_EQ("a\n", rows);
+}
+
+TEST(ConfigFile, TestRepetitionsOfConstants)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("abc=abc");
+    fakeFileReader.addLine("pad=-{10000}");
+    fakeFileReader.addLine("payload=($abc){1000,5000}");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader);
+    configFile.optimize();
+
+    Randodo::GenerationContext context;
+    ASSERT_TRUE(configFile.generate("pad", context));
+    ASSERT_EQ(std::string(10000, '-'), context.output());
+
+    // 1000 + 0, then 1000 + 1 repetitions
+    for (int count : {1000, 1001}) {
+        std::string expected = "<";
+        for (int i = 0; i < count; ++i) {
+            expected += "abc";
+        }
+        context.clear();
+        context.output() = "<";
+        ASSERT_TRUE(configFile.generate("payload", context));
+        ASSERT_EQ(expected, context.output());
+    }
+
+    // the iterative engine stops doubling at the budget
+    Randodo::GenerationBudget budget;
+    budget.maxBytes = 100;
+    budget.policy = Randodo::GenerationBudget::TRUNCATE;
+    configFile.setBudget(budget);
+    Randodo::GenerationContext budgeted;
+    ASSERT_TRUE(configFile.generate("payload", budgeted));
+    ASSERT_TRUE(configFile.budgetExceeded());
+    ASSERT_EQ(100U, budgeted.output().size());
+    ASSERT_LE(budgeted.output().capacity(), 1000U);
+
+    // and without a budget, repeats single bytes as many times as the recursive one
+    FakeFileReader recursiveReader, iterativeReader;
+    for (auto reader : {&recursiveReader, &iterativeReader}) {
+        reader->addLine("x=x{2,5}");
+        reader->addLine("y=(y){2,5}");
+    }
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> recursive(recursiveReader);
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> iterative(iterativeReader);
+    recursive.optimize();
+    iterative.optimize();
+    iterative.setIterativeEngineDepth(0);
+    for (const char *name : {"x", "y"}) {
+        for (int i = 0; i < 4; ++i) {
+            Randodo::GenerationContext context1, context2;
+            ASSERT_TRUE(recursive.generate(name, context1));
+            ASSERT_TRUE(iterative.generate(name, context2));
+            ASSERT_GE(context2.output().size(), 2U);
+            ASSERT_EQ(context1.output(), context2.output());
+        }
+    }
+}
+
+TEST(ConfigFile, TestCharClassRanges)
+{
+    Randodo::CharClass chars;
+    chars.add('x', 'z');
+    chars.add('a', 'c');
+    chars.add('b', 'f');
+    chars.add('g', 'g');
+    chars.normalize();
+    ASSERT_EQ(10U, chars.size());
+    ASSERT_EQ(2U, chars.intervals().size());
+    ASSERT_EQ("a-gx-z", chars.describe());
+    ASSERT_EQ('a', static_cast<char>(chars.at(0)));
+    ASSERT_EQ('g', static_cast<char>(chars.at(6)));
+    ASSERT_EQ('x', static_cast<char>(chars.at(7)));
+    ASSERT_EQ('z', static_cast<char>(chars.at(9)));
+    ASSERT_TRUE(chars.contains('d'));
+    ASSERT_FALSE(chars.contains('h'));
+    ASSERT_EQ("\\x00-`h-w{-\\xff", chars.negated(0, 255).describe());
+    ASSERT_EQ(246U, chars.negated(0, 255).size());
+
+    std::string listed;
+    chars.appendListed(listed);
+    ASSERT_EQ("xyzabcdefg", listed);
+}
+
+TEST(ConfigFile, TestRegexNegatedCharAlternative)
+{
+    std::string regex = "<[^a-y]>[-a][a-]";
+    std::unique_ptr<Randodo::Generator> gen = Randodo::RegexParser<FakeFileReader, FakeRandomNumberGenerator>::parseExpression(regex);
+    std::stringstream str1, str2;
+
+    gen->generate(str1);
+    gen->generate(str2);
+
+    // the 1st and the 2nd byte other than a-y, then dashes are literal at the edges
+    ASSERT_EQ(std::string("<\x00>-a", 5), str1.str());
+    ASSERT_EQ("<\x01>a-", str2.str());
+
+    Randodo::GenerationContext context;
+    Randodo::CharAlternativeGenerator<Randodo::PlainRandomNumberGenerator> allBytes(Randodo::CharClass().negated(0, 255));
+    for (int i = 0; i < 1000; ++i) {
+        allBytes.generate(context);
+    }
+    std::set<char> seen(context.output().begin(), context.output().end());
+    ASSERT_GT(seen.size(), 200U);
+}
+
+// decodes UTF-8, -1 if invalid
+static std::vector<int> codePoints(const std::string &utf8)
+{
+    std::vector<int> result;
+    for (size_t i = 0; i < utf8.size(); ) {
+        unsigned char c = utf8[i];
+        int length = c < 0x80 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+        int codePoint = length == 1 ? c : c & (0x3f >> (length - 1));
+        for (int j = 1; j < length; ++j) {
+            if (i + j >= utf8.size() || (utf8[i + j] & 0xc0) != 0x80) {
+                return std::vector<int>(1, -1);
+            }
+            codePoint = (codePoint << 6) | (utf8[i + j] & 0x3f);
+        }
+        result.push_back(codePoint);
+        i += length;
+    }
+    return result;
+}
+
+TEST(ConfigFile, TestUnicodeCharAlternatives)
+{
+    std::string regex = "[\xd0\x80-\xd3\xbf]\\u00e9[\\u{1F600}-\\u{1F64F}]";
+    std::unique_ptr<Randodo::Generator> gen = Randodo::RegexParser<FakeFileReader, FakeRandomNumberGenerator>::parseExpression(regex);
+    std::stringstream str1, str2;
+    gen->generate(str1);
+    gen->generate(str2);
+    ASSERT_EQ((std::vector<int>{0x400, 0xe9, 0x1f600}), codePoints(str1.str()));
+    ASSERT_EQ((std::vector<int>{0x401, 0xe9, 0x1f601}), codePoints(str2.str()));
+
+    Randodo::CharClass letters = Randodo::CharClass::unicodeCategory("L");
+    ASSERT_GT(letters.size(), 100000U);
+    ASSERT_TRUE(letters.contains(0x416));
+    ASSERT_FALSE(letters.contains('5'));
+    ASSERT_EQ(letters.size(), Randodo::CharClass::unicodeCategory("Lu").size()
+              + Randodo::CharClass::unicodeCategory("Ll").size() + Randodo::CharClass::unicodeCategory("Lt").size()
+              + Randodo::CharClass::unicodeCategory("Lm").size() + Randodo::CharClass::unicodeCategory("Lo").size());
+
+    gen = Randodo::RegexParser<FakeFileReader, Randodo::PlainRandomNumberGenerator>::parseExpression("\\p{L}{50}[^\\p{L}\\p{Z}]");
+    for (int i = 0; i < 20; ++i) {
+        Randodo::GenerationContext context;
+        gen->generate(context);
+        std::vector<int> generated = codePoints(context.output());
+        ASSERT_EQ(51U, generated.size());
+        for (int j = 0; j < 50; ++j) {
+            ASSERT_TRUE(letters.contains(generated[j]));
+        }
+        ASSERT_FALSE(letters.contains(generated[50]));
+        ASSERT_FALSE(generated[50] >= 0xd800 && generated[50] <= 0xdfff);
+        ASSERT_NE(' ', generated[50]);
+    }
+
+    auto error = [](const std::string &regex) {
+        std::string errMsg;
+        Randodo::MapOfGenerators generatorsMap;
+        Randodo::RegexParser<FakeFileReader, FakeRandomNumberGenerator>::parseExpression(regex, generatorsMap, nullptr,
+                                                                                          nullptr, &errMsg);
+        return errMsg;
+    };
+    ASSERT_EQ("", error("\\u{41}\\u0041[\\u{10FFFF}]"));
+    ASSERT_EQ("Invalid code point zz", error("\\u{zz}"));
+    ASSERT_EQ("Invalid code point 100000041", error("\\u{100000041}"));
+    ASSERT_EQ("Invalid code point 110000", error("[\\u{110000}]"));
+    ASSERT_EQ("Invalid code point d800", error("\\ud800"));
+    ASSERT_EQ("Invalid code point ", error("\\u{}"));
+    ASSERT_EQ("Invalid byte +f", error("\\x{+f}"));
+}
+
+TEST(ConfigFile, TestBinaryEscapes)
+{
+    std::string regex = "a\\x00\\xff[\\x{fe}-\\xff]\xff|";
+    std::unique_ptr<Randodo::Generator> gen = Randodo::RegexParser<FakeFileReader, FakeRandomNumberGenerator>::parseExpression(regex);
+    Randodo::GenerationContext context;
+    gen->generate(context);
+    ASSERT_EQ(std::string("a\0\xff\xfe\xff", 5), context.output());
+
+    // in a class of code points it's U+00FF, in UTF-8
+    gen = Randodo::RegexParser<FakeFileReader, FakeRandomNumberGenerator>::parseExpression("[\\xff\\u0100]");
+    context.clear();
+    gen->generate(context);
+    ASSERT_EQ("\xc3\xbf", context.output());
+
+    // bytes of unfinished UTF-8 characters, and of surrogates, are taken as bytes
+    auto generatedBy = [](const std::string &regex) {
+        auto generator = Randodo::RegexParser<FakeFileReader, FakeRandomNumberGenerator>::parseExpression(regex);
+        std::set<std::string> generated;
+        for (int i = 0; i < 10; ++i) {
+            Randodo::GenerationContext context;
+            generator->generate(context);
+            generated.insert(context.output());
+        }
+        return generated;
+    };
+    ASSERT_EQ((std::set<std::string>{"\xc3", "x"}), generatedBy("[\xc3x]"));
+    ASSERT_EQ((std::set<std::string>{"\xc3", "-"}), generatedBy("[\xc3-]"));
+    ASSERT_EQ((std::set<std::string>{"\xe2", "\x82", "z"}), generatedBy("[\xe2\x82z]"));
+    ASSERT_EQ((std::set<std::string>{"\xed", "\xa0", "\x80"}), generatedBy("[\xed\xa0\x80]"));
+    ASSERT_EQ((std::set<std::string>{"\xe2\x82\xac"}), generatedBy("[\xe2\x82\xac]"));
+}
+
+TEST(ConfigFile, TestRandomBytes)
+{
+    auto gen = Randodo::RegexParser<FakeFileReader, Randodo::XoshiroLanesRandomNumberGenerator>::parseExpression("<{bytes:4096}>");
+    Randodo::GenerationContext context;
+    gen->generate(context);
+    ASSERT_EQ(4098U, context.output().size());
+    std::set<char> bytes(context.output().begin() + 1, context.output().end() - 1);
+    ASSERT_EQ(256U, bytes.size());
+
+    gen = Randodo::RegexParser<FakeFileReader, Randodo::PlainRandomNumberGenerator>::parseExpression("{bytes:2..5}");
+    for (int i = 0; i < 50; ++i) {
+        context.clear();
+        gen->generate(context);
+        ASSERT_GE(context.output().size(), 2U);
+        ASSERT_LE(context.output().size(), 5U);
+    }
+    ASSERT_EQ(5U, Randodo::worstCase(gen.get()).bytes);
+}
+
+TEST(ConfigFile, TestDfa)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("id=[A-Z]{3}-[0-9]{2,4}");
+    fakeFileReader.addLine("row=($id|none)(,$id){0,2}");
+    fakeFileReader.addLine("word=[\\u0400-\\u04ff\\u{1F600}]{1,3}(\\x00|)");
+    fakeFileReader.addLine("self=(x|$self)");
+    fakeFileReader.addLine("long=[a-z]{1,20000}");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> configFile(fakeFileReader);
+
+    Randodo::Dfa dfa;
+    ASSERT_FALSE(dfa.match("ABC-12"));
+
+    // long chains compile in linear time: a state after every number of letters, and the
+    // dead one
+    ASSERT_TRUE(configFile.compileDfa("long", dfa));
+    ASSERT_EQ(20002U, dfa.states());
+    ASSERT_TRUE(dfa.match(std::string(20000, 'q')));
+    ASSERT_FALSE(dfa.match(std::string(20001, 'q')));
+
+    ASSERT_TRUE(configFile.compileDfa("row", dfa));
+    ASSERT_TRUE(dfa.match("ABC-12"));
+    ASSERT_TRUE(dfa.match("none,ABC-1234,XYZ-000"));
+    ASSERT_FALSE(dfa.match(""));
+    ASSERT_FALSE(dfa.match("ABC-1"));
+    ASSERT_FALSE(dfa.match("ABC-12,"));
+    ASSERT_FALSE(dfa.match("none,none,none,none"));
+    // minimal: 12 states for the first value (after `none` and after 4 digits are the same
+    // state), 9 for each of the other two and the dead one
+    ASSERT_EQ(31U, dfa.states());
+
+    ASSERT_FALSE(configFile.compileDfa("self", dfa));
+    ASSERT_FALSE(configFile.compileDfa("undefined", dfa));
+
+    ASSERT_TRUE(configFile.compileDfa("word", dfa));
+    ASSERT_TRUE(dfa.match("\xd0\x96\xf0\x9f\x98\x80"));
+    ASSERT_FALSE(dfa.match("\xd0"));
+    ASSERT_FALSE(dfa.match("\xf0\x9f\x98\x81"));
+
+    std::vector<std::string> rows;
+    Randodo::GenerationContext context;
+    for (int i = 0; i < 1000; ++i) {
+        context.clear();
+        configFile.generate(i % 2 ? "word" : "id", context);
+        rows.push_back(context.output());
+    }
+    std::unique_ptr<bool[]> matches(new bool[rows.size()]);
+    ASSERT_EQ(500U, dfa.matchMany(rows.data(), rows.size(), matches.get()));
+    for (size_t i = 0; i < rows.size(); ++i) {
+        ASSERT_EQ(i % 2 == 1, matches[i]);
+    }
+}
+
+TEST(ConfigFile, TestEnumeration)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("x=(a|b|a)[0-1]{0,1}");
+    fakeFileReader.addLine("big=[a-z]{20}");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader);
+
+    Randodo::Dfa dfa;
+    ASSERT_TRUE(configFile.compileDfa("x", dfa));
+    ASSERT_EQ("6", Randodo::formatLanguageSize(dfa.languageSize()));
+    std::vector<std::string> all;
+    for (Randodo::Dfa::Enumerator enumerator(dfa); enumerator.valid(); enumerator.next()) {
+        all.push_back(enumerator.string());
+    }
+    ASSERT_EQ((std::vector<std::string>{"a", "a0", "a1", "b", "b0", "b1"}), all);
+    std::string string;
+    for (size_t i = 0; i < all.size(); ++i) {
+        ASSERT_TRUE(dfa.unrank(i, string));
+        ASSERT_EQ(all[i], string);
+    }
+    ASSERT_FALSE(dfa.unrank(6, string));
+    Randodo::Dfa::Enumerator fromThird(dfa, 3);
+    ASSERT_EQ("b", fromThird.string());
+
+    ASSERT_TRUE(configFile.compileDfa("big", dfa));
+    ASSERT_EQ("19928148895209409152340197376", Randodo::formatLanguageSize(dfa.languageSize()));
+    Randodo::Dfa::Enumerator middle(dfa, dfa.languageSize() / 2);
+    ASSERT_EQ("naaaaaaaaaaaaaaaaaaa", middle.string());
+    middle.next();
+    ASSERT_EQ("naaaaaaaaaaaaaaaaaab", middle.string());
+}
+
+TEST(ConfigFile, TestExactLength)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("name=(Ann|Sharon|Liza)");
+    fakeFileReader.addLine("id=[0-9]{1,6}");
+    fakeFileReader.addLine("key=$name-$id-[a-z]{1,200}");
+    fakeFileReader.addLine("word=[a\\u00e9\\u{1F600}]{1,10}");
+    fakeFileReader.addLine("self=(x|$self)");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> configFile(fakeFileReader);
+    auto &generators = configFile.getMapOfGenerators();
+
+    Randodo::ExactLengthSampler<> key(*generators.get(generators.lookup("key")), 128, 128);
+    ASSERT_TRUE(key.possible());
+    std::set<std::string> names;
+    for (int i = 0; i < 100; ++i) {
+        Randodo::GenerationContext context;
+        ASSERT_TRUE(key.generate(context));
+        ASSERT_EQ(128U, context.output().size());
+        names.insert(context.output().substr(0, context.output().find('-')));
+    }
+    // every string is equally likely, and there are 26^3 times more with Ann than with Sharon
+    ASSERT_EQ(1U, names.count("Ann"));
+    ASSERT_EQ(0U, names.count("Sharon"));
+
+    // 1, 2 or 4 bytes per character
+    Randodo::ExactLengthSampler<> word(*generators.get(generators.lookup("word")), 7, 7);
+    for (int i = 0; i < 100; ++i) {
+        Randodo::GenerationContext context;
+        ASSERT_TRUE(word.generate(context));
+        ASSERT_EQ(7U, context.output().size());
+    }
+
+    ASSERT_FALSE(Randodo::ExactLengthSampler<>(*generators.get(generators.lookup("key")), 300, 400).possible());
+    ASSERT_FALSE(Randodo::ExactLengthSampler<>(*generators.get(generators.lookup("self")), 1, 10).possible());
+    Randodo::ExactLengthSampler<> ids(*generators.get(generators.lookup("id")), 2, 3);
+    ASSERT_EQ(1100.0L, ids.ways());
+
+    // counts far beyond long double: every split of 5000 is as likely
+    FakeFileReader longReader;
+    longReader.addLine("split=[a-m]{0,3000}[n-z]{0,3000}");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> longFile(longReader);
+    auto &longGenerators = longFile.getMapOfGenerators();
+    Randodo::ExactLengthSampler<> split(*longGenerators.get(longGenerators.lookup("split")), 5000, 5000);
+    ASSERT_TRUE(split.possible());
+    ASSERT_TRUE(std::isinf(split.ways()));
+    std::set<size_t> splits;
+    for (int i = 0; i < 50; ++i) {
+        Randodo::GenerationContext context;
+        ASSERT_TRUE(split.generate(context));
+        ASSERT_EQ(5000U, context.output().size());
+        size_t at = context.output().find_first_of("nopqrstuvwxyz");
+        ASSERT_GE(at, 2000U);
+        ASSERT_LE(at, 3000U);
+        splits.insert(at);
+    }
+    ASSERT_GT(splits.size(), 40U);
+
+    // counting recurses, so chains too deep for the stack aren't counted
+    FakeFileReader chainReader;
+    chainReader.addLine("a0=x");
+    for (int i = 1; i <= 20000; ++i) {
+        chainReader.addLine("a" + std::to_string(i) + "=$a" + std::to_string(i - 1));
+    }
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> chainFile(chainReader);
+    auto &chain = chainFile.getMapOfGenerators();
+    ASSERT_FALSE(Randodo::ExactLengthSampler<>(*chain.get(chain.lookup("a20000")), 1, 1).possible());
+    Randodo::ExactLengthSampler<> shallow(*chain.get(chain.lookup("a100")), 1, 1);
+    ASSERT_TRUE(shallow.possible());
+    Randodo::GenerationContext context;
+    ASSERT_TRUE(shallow.generate(context));
+    ASSERT_EQ("x", context.output());
+}
+
+TEST(ConfigFile, TestSortedSample)
+{
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("id=[A-Z]{3}-[0-9]{6}");
+    fakeFileReader.addLine("short=[A-Z]{2}[0-9]{2}");
+    Randodo::ConfigFile<FakeFileReader, FakeRandomNumberGenerator> configFile(fakeFileReader);
+    Randodo::Dfa dfa;
+    std::string row;
+    ASSERT_FALSE(dfa.unrank(0, row));
+
+    // a sparse and a dense sample
+    for (const char *name : {"id", "short"}) {
+        ASSERT_TRUE(configFile.compileDfa(name, dfa));
+        ASSERT_TRUE(dfa.languageSizeExact());
+        Randodo::LanguageSize count = std::string(name) == "id" ? 10000 : dfa.languageSize() / 2;
+        Randodo::SortedSample<> sample(0, dfa.languageSize(), count);
+        std::string previous;
+        Randodo::LanguageSize drawn = 0, index, sum = 0;
+        while (sample.next(index)) {
+            ASSERT_TRUE(dfa.unrank(index, row));
+            ASSERT_LT(previous, row);
+            ASSERT_TRUE(dfa.match(row));
+            previous = row;
+            sum += index;
+            drawn++;
+        }
+        ASSERT_TRUE(drawn == count);
+        // the average index is about the middle
+        long double average = static_cast<long double>(sum) / count / static_cast<long double>(dfa.languageSize());
+        ASSERT_NEAR(0.5, static_cast<double>(average), 0.01);
+    }
+
+    // just under the density of selection sampling, every index is as likely as any other
+    const int samples = 4000;
+    std::vector<int> taken(1000, 0);
+    int adjacent = 0;
+    for (int i = 0; i < samples; ++i) {
+        Randodo::SortedSample<> sparse(0, 1000, 240);
+        Randodo::LanguageSize index, previous = 1000;
+        while (sparse.next(index)) {
+            taken[static_cast<size_t>(index)]++;
+            adjacent += index == previous + 1;
+            previous = index;
+        }
+    }
+    for (size_t at : {0, 1, 500, 998, 999}) {
+        ASSERT_NEAR(0.24, taken[at] / double(samples), 0.025) << at;
+    }
+    for (size_t at = 0; at < 1000; at += 100) {
+        int share = std::accumulate(taken.begin() + at, taken.begin() + at + 100, 0);
+        ASSERT_NEAR(0.24, share / (100.0 * samples), 0.005) << at;
+    }
+    // any two neighbours are both taken with probability 240 * 239 / (1000 * 999), so 240 / 1000
+    // of the 239 gaps of a sample are of 1
+    ASSERT_NEAR(0.24, adjacent / (239.0 * samples), 0.005);
+
+    Randodo::SortedSample<> all(10, 20, 100);
+    Randodo::LanguageSize index;
+    for (int i = 10; i < 20; ++i) {
+        ASSERT_TRUE(all.next(index));
+        ASSERT_TRUE(index == Randodo::LanguageSize(i));
+    }
+    ASSERT_FALSE(all.next(index));
+}
+
+TEST(ConfigFile, TestDistributions)
+{
+    typedef Randodo::RegexParser<FakeFileReader, Randodo::XoshiroLanesRandomNumberGenerator> Parser;
+    auto gen = Parser::parseExpression("(a|b|c|d){~zipf:1}[0-9]{~hist:1,0}[a-z]{~exp:1}");
+    Randodo::GenerationContext context;
+    std::map<char, int> alternatives, letters;
+    const int rows = 100000;
+    for (int i = 0; i < rows; ++i) {
+        context.clear();
+        gen->generate(context);
+        ASSERT_EQ(3U, context.output().size());
+        ASSERT_LT(context.output()[1], '5');
+        alternatives[context.output()[0]]++;
+        letters[context.output()[2]]++;
+    }
+    // 1 : 1/2 : 1/3 : 1/4
+    ASSERT_NEAR(12.0 / 25, alternatives['a'] / double(rows), 0.01);
+    ASSERT_NEAR(3.0 / 25, alternatives['d'] / double(rows), 0.01);
+    ASSERT_NEAR(1 - std::exp(-1), letters['a'] / double(rows), 0.01);
+    ASSERT_NEAR(std::exp(-1) - std::exp(-2), letters['b'] / double(rows), 0.01);
+
+    Randodo::Distribution distribution;
+    ASSERT_FALSE(Randodo::Distribution::parse("zipf:-1", distribution));
+    ASSERT_FALSE(Randodo::Distribution::parse("zipf", distribution));
+    ASSERT_FALSE(Randodo::Distribution::parse("hist:0,0", distribution));
+}
+
+TEST(ConfigFile, TestSkewedLanguageSample)
+{
+    // rejection-inversion over a million strings: P(first) = 1 / sum of 1 / k^1.5
+    Randodo::Distribution zipf;
+    ASSERT_TRUE(Randodo::Distribution::parse("zipf:1.5", zipf));
+    const Randodo::LanguageSize size = 1000000;
+    double harmonic = 0;
+    for (int k = 1; k <= 1000000; ++k) {
+        harmonic += std::pow(k, -1.5);
+    }
+    Randodo::SkewedLanguageSample<Randodo::XoshiroLanesRandomNumberGenerator> ranks(zipf, size, false);
+    Randodo::SkewedLanguageSample<Randodo::XoshiroLanesRandomNumberGenerator> scrambled(zipf, size);
+    std::map<Randodo::LanguageSize, int> counts, scrambledCounts;
+    const int rows = 100000;
+    for (int i = 0; i < rows; ++i) {
+        Randodo::LanguageSize rank = ranks.next(), index = scrambled.next();
+        ASSERT_TRUE(rank < size && index < size);
+        counts[rank]++;
+        scrambledCounts[index]++;
+    }
+    ASSERT_NEAR(1 / harmonic, counts[0] / double(rows), 0.01);
+    ASSERT_NEAR(std::pow(2, -1.5) / harmonic, counts[1] / double(rows), 0.01);
+    // the same skew, elsewhere
+    ASSERT_LT(scrambledCounts[1], rows / 100);
+    int hottest = 0;
+    for (auto &count : scrambledCounts) {
+        hottest = std::max(hottest, count.second);
+    }
+    ASSERT_NEAR(1 / harmonic, hottest / double(rows), 0.01);
+}
+
+TEST(ConfigFile, TestCountDistributions)
+{
+    typedef Randodo::RegexParser<FakeFileReader, Randodo::XoshiroLanesRandomNumberGenerator> Parser;
+    // average count, and how often it's `count`
+    auto average = [](const std::string &regex, size_t count, double &share) {
+        auto gen = Parser::parseExpression(regex);
+        Randodo::GenerationContext context;
+        const int rows = 100000;
+        double sum = 0;
+        share = 0;
+        for (int i = 0; i < rows; ++i) {
+            context.clear();
+            gen->generate(context);
+            sum += context.output().size();
+            share += context.output().size() == count ? 1.0 / rows : 0;
+        }
+        return sum / rows;
+    };
+    double share;
+    ASSERT_NEAR(1, average("x*", 0, share), 0.03);
+    ASSERT_NEAR(0.5, share, 0.01);
+    ASSERT_NEAR(2, average("x+", 0, share), 0.03);
+    ASSERT_EQ(0, share);
+    ASSERT_NEAR(0.5, average("x?", 0, share), 0.01);
+    ASSERT_NEAR(5, average("x{0,100}{~poisson:5}", 5, share), 0.05);
+    ASSERT_NEAR(std::pow(5, 5) * std::exp(-5) / 120, share, 0.01);
+    ASSERT_NEAR(20, average("x{10,30}{~normal:20,3}", 20, share), 0.05);
+    ASSERT_NEAR(1.75, average("x*{~hist:0,1,3}", 0, share), 0.01);
+    ASSERT_EQ(0, share);
+    ASSERT_NEAR(4, average("x{3,}", 3, share), 0.03);
+    ASSERT_NEAR(0.5, share, 0.01);
+    ASSERT_EQ(84U, Randodo::worstCase(Parser::parseExpression("x*").get()).bytes);
+
+    // samplers for wide ranges
+    ASSERT_NEAR(50, average("x{0,100000}{~poisson:50}", 50, share), 0.2);
+    ASSERT_NEAR(std::exp(50 * std::log(50) - 50 - std::lgamma(51)), share, 0.01);
+    ASSERT_NEAR(500, average("x{0,100000}{~normal:500,50}", 0, share), 1);
+    ASSERT_NEAR(std::exp(3.125), average("x{1,100000}{~lognormal:3,0.5}", 0, share), 0.3);
+    ASSERT_NEAR(10, average("x{0,100000}{~geometric:10}", 0, share), 0.2);
+    average("x{5,100000}{~zipf:2}", 5, share);
+    ASSERT_NEAR((1 / 36.0) / (M_PI * M_PI / 6 - 1 - 1 / 4.0 - 1 / 9.0 - 1 / 16.0 - 1 / 25.0), share, 0.01);
+}
+
+TEST(ConfigFile, TestIntegers)
+{
+    std::string output;
+    Randodo::appendSigned(output, INT64_MIN);
+    Randodo::appendSigned(output, INT64_MAX);
+    Randodo::appendUnsigned(output, UINT64_MAX);
+    Randodo::appendSigned(output, -7, 10, 3);
+    Randodo::appendUnsigned(output, 0);
+    Randodo::appendUnsigned(output, 0xbeef, 16, 6, true);
+    Randodo::appendUnsigned(output, 5, 2);
+    Randodo::appendUnsigned(output, 35, 36);
+    ASSERT_EQ("-9223372036854775808" "9223372036854775807" "18446744073709551615" "-007" "0" "00BEEF" "101" "z",
+              output);
+
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("n={int:-120..3000,pad=2}");
+    fakeFileReader.addLine("h={int:0..300,HEX,pad=2}");
+    fakeFileReader.addLine("big={int:1..1000000}");
+    fakeFileReader.addLine("wide={int:0..1999999999}");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> configFile(fakeFileReader);
+    Randodo::Dfa n, h;
+    ASSERT_TRUE(configFile.compileDfa("n", n));
+    ASSERT_TRUE(configFile.compileDfa("h", h));
+    ASSERT_TRUE(n.languageSize() == 3121);
+    for (int value = -1000; value < 5000; ++value) {
+        std::string decimal, hex;
+        Randodo::appendSigned(decimal, value, 10, 2);
+        Randodo::appendSigned(hex, value, 16, 2, true);
+        ASSERT_EQ(value >= -120 && value <= 3000, n.match(decimal)) << decimal;
+        ASSERT_EQ(value >= 0 && value <= 300, h.match(hex)) << hex;
+    }
+    ASSERT_FALSE(n.match("007"));
+    ASSERT_FALSE(h.match("0a"));
+
+    Randodo::GenerationContext context;
+    int64_t least = INT64_MAX, most = 0;
+    for (int i = 0; i < 10000; ++i) {
+        context.clear();
+        configFile.generate("big", context);
+        ASSERT_NE('0', context.output()[0]);
+        int64_t value = std::stoll(context.output());
+        least = std::min(least, value);
+        most = std::max(most, value);
+    }
+    ASSERT_GE(least, 1);
+    ASSERT_LT(least, 1000);
+    ASSERT_LE(most, 1000000);
+    ASSERT_GT(most, 999000);
+
+    // 2^31 % 2000000000 is 147483648: get() % n would draw less than that twice as often
+    int low = 0;
+    for (int i = 0; i < 20000; ++i) {
+        context.clear();
+        configFile.generate("wide", context);
+        low += std::stoll(context.output()) < 147483648;
+    }
+    ASSERT_GT(low, 20000 * 0.06);
+    ASSERT_LT(low, 20000 * 0.09);
+    struct RejectedLast
+    {
+        int calls = 0;
+        int get()
+        {
+            return calls++ == 0 ? 2000000000 : 5;
+        }
+    } rejectedLast;
+    ASSERT_EQ(5U, Randodo::randomBelow64(rejectedLast, 2000000000));
+
+    auto &generators = configFile.getMapOfGenerators();
+    Randodo::ExactLengthSampler<> three(*generators.get(generators.lookup("big")), 3, 3);
+    for (int i = 0; i < 100; ++i) {
+        context.clear();
+        three.generate(context);
+        ASSERT_EQ(3U, context.output().size());
+    }
+}
+
+TEST(ConfigFile, TestFloats)
+{
+    std::string output;
+    for (double value : {0.1, 100.0, -2.5, 1e-7, 0.000001, 1.5e300, 1e21, 1e20, 5e-324, 0.0}) {
+        Randodo::appendDouble(output, value);
+        output += ' ';
+    }
+    ASSERT_EQ("0.1 100.0 -2.5 1e-7 0.000001 1.5e300 1e21 100000000000000000000.0 5e-324 0.0 ", output);
+    Randodo::PlainRandomNumberGenerator rng;
+    for (int i = 0; i < 100000; ++i) {
+        uint64_t bits = Randodo::random64(rng);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (std::isfinite(value)) {
+            output.clear();
+            Randodo::appendDouble(output, value);
+            ASSERT_EQ(value, strtod(output.c_str(), nullptr)) << output;
+        }
+    }
+
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("price={float:0.1..99.99,precision=2}");
+    fakeFileReader.addLine("latitude={float:-90..90,precision=6}");
+    fakeFileReader.addLine("x={float:-1..1}");
+    fakeFileReader.addLine("weight={float:0..10}{~normal:7,0.5}");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> configFile(fakeFileReader);
+    Randodo::Dfa price, latitude;
+    ASSERT_TRUE(configFile.compileDfa("price", price));
+    ASSERT_TRUE(configFile.compileDfa("latitude", latitude));
+    ASSERT_FALSE(configFile.compileDfa("x", latitude));
+    ASSERT_TRUE(price.languageSize() == 9990);
+    ASSERT_TRUE(price.match("0.10"));
+    ASSERT_TRUE(price.match("99.99"));
+    ASSERT_FALSE(price.match("0.09"));
+    ASSERT_FALSE(price.match("00.10"));
+    ASSERT_FALSE(price.match(".50"));
+    ASSERT_FALSE(price.match("5.5"));
+    ASSERT_TRUE(latitude.match("-0.000001"));
+    ASSERT_FALSE(latitude.match("-90.000001"));
+
+    Randodo::GenerationContext context;
+    double sum = 0;
+    for (int i = 0; i < 10000; ++i) {
+        context.clear();
+        configFile.generate("latitude", context);
+        ASSERT_TRUE(latitude.match(context.output())) << context.output();
+        context.clear();
+        configFile.generate("x", context);
+        double x = strtod(context.output().c_str(), nullptr);
+        ASSERT_TRUE(x >= -1 && x < 1) << context.output();
+        context.clear();
+        configFile.generate("weight", context);
+        sum += strtod(context.output().c_str(), nullptr);
+    }
+    ASSERT_NEAR(7, sum / 10000, 0.05);
+}
+
+TEST(ConfigFile, TestDates)
+{
+    ASSERT_EQ(0, Randodo::daysFromCivil(1970, 1, 1));
+    ASSERT_EQ(19782, Randodo::daysFromCivil(2024, 2, 29));
+    ASSERT_EQ(-25567, Randodo::daysFromCivil(1900, 1, 1));
+    for (int64_t days = -800000; days < 800000; days += 7) {
+        int64_t year;
+        unsigned month, day;
+        Randodo::civilFromDays(days, year, month, day);
+        ASSERT_EQ(days, Randodo::daysFromCivil(year, month, day));
+    }
+
+    FakeFileReader fakeFileReader;
+    fakeFileReader.addLine("day={date:2024-02-28..2024-03-01,date}");
+    fakeFileReader.addLine("ms={date:1969-12-31T23:59:59.999..1970-01-01T00:00:00.001Z,iso-ms}");
+    fakeFileReader.addLine("epoch={date:2024-01-01T00:00:00..2024-01-01T00:00:09,epoch}");
+    fakeFileReader.addLine("series={date:2024-01-01..2024-01-01T01:00:00,monotonic=1m}");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> configFile(fakeFileReader);
+    std::set<std::string> days, milliseconds, epochs;
+    Randodo::GenerationContext context;
+    for (int i = 0; i < 1000; ++i) {
+        context.clear();
+        configFile.generate("day", context);
+        days.insert(context.output());
+        context.clear();
+        configFile.generate("ms", context);
+        milliseconds.insert(context.output());
+        context.clear();
+        configFile.generate("epoch", context);
+        epochs.insert(context.output());
+    }
+    ASSERT_EQ((std::set<std::string>{"2024-02-28", "2024-02-29", "2024-03-01"}), days);
+    ASSERT_EQ((std::set<std::string>{"1969-12-31T23:59:59.999Z", "1970-01-01T00:00:00.000Z",
+                                     "1970-01-01T00:00:00.001Z"}), milliseconds);
+    ASSERT_EQ(10U, epochs.size());
+    ASSERT_EQ("1704067200", *epochs.begin());
+
+    std::string previous;
+    for (int i = 0; i < 1000; ++i) {
+        context.clear();
+        configFile.generate("series", context);
+        ASSERT_EQ(20U, context.output().size());
+        ASSERT_LE(previous, context.output());
+        ASSERT_LE(context.output(), "2024-01-01T01:00:00Z");
+        previous = context.output();
+    }
+    ASSERT_EQ("2024-01-01T01:00:00Z", previous);
+
+    // distributions are of the offset from the start in every format
+    FakeFileReader skewedReader;
+    skewedReader.addLine("epoch={date:2024-01-01..2024-01-01,epoch}{~normal:43200,3600}");
+    skewedReader.addLine("iso={date:2024-01-01..2024-01-01}{~normal:43200,3600}");
+    Randodo::ConfigFile<FakeFileReader, Randodo::PlainRandomNumberGenerator> skewed(skewedReader);
+    double epochSum = 0, isoSum = 0;
+    for (int i = 0; i < 1000; ++i) {
+        context.clear();
+        skewed.generate("epoch", context);
+        epochSum += strtod(context.output().c_str(), nullptr) - 1704067200;
+        context.clear();
+        skewed.generate("iso", context);
+        ASSERT_EQ("2024-01-01T", context.output().substr(0, 11));
+        isoSum += atoi(context.output().c_str() + 11) * 3600 + atoi(context.output().c_str() + 14) * 60
+            + atoi(context.output().c_str() + 17);
+    }
+    ASSERT_NEAR(43200, epochSum / 1000, 600);
+    ASSERT_NEAR(43200, isoSum / 1000, 600);
+}